@@ -0,0 +1,434 @@
+//Kernel harnesses shared by the benchmark and the golden output test; each drives one kernel mode
+//from a fresh state with precomputed stimuli and hands every output buffer to a recorder with add()
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "../src/kernel/BCrushKernel.hpp"
+#include "../src/kernel/ClipKernel.hpp"
+#include "../src/kernel/ClockDivKernel.hpp"
+#include "../src/kernel/RemainderKernel.hpp"
+
+//signals repeat after this many frames so they are generated ahead of timing
+static const int PERIOD = 4096;
+static const float SAMPLE_RATE = 48000.f;
+
+//stimulus voltages are integer multiples of this step below 16 V, so every value converts to
+//float exactly
+static const float VOLT_STEP = 1.f / 1048576.f;
+
+//sine of a 32 bit phase in units of 2^-30 from integer math, so the stimuli come out the same
+//for any float flags and C library; an odd polynomial within 4e-4 of sin, reaching 1 at the peak
+inline int64_t sineFixed(uint32_t phase) {
+	//fold onto -pi/2 to pi/2, where x runs from -2^30 to 2^30
+	int64_t x = int32_t(phase);
+	if(x > (int64_t(1) << 30))
+		x = (int64_t(1) << 31) - x;
+	else if(x < -(int64_t(1) << 30))
+		x = -(int64_t(1) << 31) - x;
+	//x * (pi/2 - x^2 * (b - x^2 * c)) with the peak value and slope of sin at x = 1
+	const int64_t x2 = (x * x) >> 30;
+	int64_t y = 76016977;
+	y = 688904866 - ((x2 * y) >> 30);
+	y = 1686629713 - ((x2 * y) >> 30);
+	return (x * y) >> 30;
+}
+
+//precomputed voltages of one port for every channel
+struct TestSignal {
+	std::vector<float> table;
+	int channels = 0;
+
+	//frequencies are whole Hz so the phase increments are integers too
+	void sine(int channels, int freq, float amplitude, float offset = 0.f) {
+		init(channels);
+		for(int c = 0; c < channels; ++c) {
+			//detune channels so lanes differ
+			const uint64_t increment = (uint64_t(freq) * (100 + c) << 32) / (100 * int64_t(SAMPLE_RATE));
+			uint32_t phase = 0;
+			for(int i = 0; i < PERIOD; ++i) {
+				table[i * 16 + c] = toVoltage(offset, amplitude, sineFixed(phase));
+				phase += uint32_t(increment);
+			}
+		}
+	}
+	//linear sweep from freq to freq * ratio over each period
+	void sweep(int channels, int freq, int ratio, float amplitude) {
+		init(channels);
+		for(int c = 0; c < channels; ++c) {
+			const uint64_t start = (uint64_t(freq) * (100 + c) << 32) / (100 * int64_t(SAMPLE_RATE));
+			uint32_t phase = 0;
+			for(int i = 0; i < PERIOD; ++i) {
+				table[i * 16 + c] = toVoltage(0.f, amplitude, sineFixed(phase));
+				phase += uint32_t(start * (PERIOD + uint64_t(ratio - 1) * i) / PERIOD);
+			}
+		}
+	}
+	//uniform noise from a fixed seed so every run sees the same voltages
+	void noise(int channels, float amplitude) {
+		init(channels);
+		uint32_t state = 22222;
+		for(int i = 0; i < PERIOD * 16; ++i) {
+			state = state * 1664525u + 1013904223u;
+			//top 31 bits as -1 to 1 in units of 2^-30
+			table[i] = toVoltage(0.f, amplitude, int64_t(state >> 1) - (int64_t(1) << 30));
+		}
+	}
+	void pulse(int channels, int period, float high = 10.f) {
+		init(channels);
+		for(int i = 0; i < PERIOD; ++i) {
+			for(int c = 0; c < channels; ++c)
+				table[i * 16 + c] = ((i + c) % period < period / 2)? high : 0.f;
+		}
+	}
+	//offset + amplitude * unit, where unit is in units of 2^-30, rounded down to a VOLT_STEP
+	static float toVoltage(float offset, float amplitude, int64_t unit) {
+		const int64_t steps = int64_t(offset / VOLT_STEP) + ((int64_t(amplitude / VOLT_STEP) * unit) >> 30);
+		return float(steps) * VOLT_STEP;
+	}
+	void init(int channels) {
+		this->channels = channels;
+		table.assign(PERIOD * 16, 0.f);
+	}
+	Signal at(int frame) const {
+		if(channels == 0)
+			return Signal();
+		return Signal(&table[(frame % PERIOD) * 16], channels);
+	}
+};
+
+struct ClipBench {
+	ClipKernel kernel;
+	ClipKernel::Controls controls;
+	TestSignal audio, gain, pushSize, pushPos, limitSize, limitPos;
+	float out[16] = {};
+	int channels;
+
+	ClipBench(int channels, bool connected) : channels(channels) {
+		controls.gain = 1.f;
+		controls.push = 0.2f;
+		controls.limit = 0.8f;
+		controls.pull = false;
+		controls.enableLimit = true;
+		audio.sine(channels, 220, 8.f);
+		if(connected) {
+			audio.sweep(channels, 20, 1000, 8.f);
+			gain.sine(channels, 1, 5.f);
+			pushSize.sine(channels, 2, 2.f);
+			pushPos.sine(channels, 3, 1.f);
+			limitSize.sine(channels, 4, 2.f);
+			limitPos.noise(channels, 1.f);
+		}
+	}
+	void process(int frame) {
+		ClipKernel::Inputs in;
+		in.audio = audio.at(frame);
+		in.gain = gain.at(frame);
+		in.pushSize = pushSize.at(frame);
+		in.pushPos = pushPos.at(frame);
+		in.limitSize = limitSize.at(frame);
+		in.limitPos = limitPos.at(frame);
+		kernel.process(controls, in, out, channels);
+	}
+	float sink() {
+		return out[0];
+	}
+	template <typename TRecorder>
+	void digest(TRecorder &recorder) const {
+		recorder.add(out, channels);
+	}
+};
+
+//mono CV cables on polyphonic audio are broadcast to every channel
+struct ClipMonoCvBench : ClipBench {
+	ClipMonoCvBench(int channels, bool connected) : ClipBench(channels, connected) {
+		if(connected) {
+			gain.sine(1, 1, 5.f);
+			pushSize.sine(1, 2, 2.f);
+			pushPos.sine(1, 3, 1.f);
+			limitSize.sine(1, 4, 2.f);
+			limitPos.noise(1, 1.f);
+		}
+	}
+};
+
+struct ClipBandsBench : ClipBench {
+	ClipBandsBench(int channels, bool connected) : ClipBench(channels, connected) {
+		kernel.setSampleRate(SAMPLE_RATE);
+		kernel.bands = 3;
+		kernel.bandPush[0] = 0.5f;
+		kernel.bandLimit[2] = 1.5f;
+	}
+};
+
+struct ClipLookaheadBench : ClipBench {
+	ClipLookaheadBench(int channels, bool connected) : ClipBench(channels, connected) {
+		kernel.setSampleRate(SAMPLE_RATE);
+		kernel.lookahead = true;
+		kernel.limiter.lookahead = 5.f;
+	}
+};
+
+//lookahead dragged back and forth between 1 and 8 ms in steps every 32 frames
+struct ClipLookaheadDragBench : ClipLookaheadBench {
+	ClipLookaheadDragBench(int channels, bool connected) : ClipLookaheadBench(channels, connected) {}
+	void process(int frame) {
+		const int step = (frame / 32) % 30;
+		kernel.limiter.lookahead = 1.f + 0.5f * ((step < 15)? step : 29 - step);
+		ClipLookaheadBench::process(frame);
+	}
+};
+
+struct ClipAdaaBench : ClipBench {
+	ClipAdaaBench(int channels, bool connected) : ClipBench(channels, connected) {
+		kernel.antiAlias = true;
+	}
+};
+
+struct RemainderBench {
+	RemainderKernel kernel;
+	RemainderKernel::Controls controls;
+	TestSignal audio, gain, feedback, shape, mix, fold;
+	float out[16] = {};
+	int channels;
+
+	RemainderBench(int channels, bool connected) : channels(channels) {
+		controls.gain = 2.f;
+		controls.gainCv = 0.5f;
+		controls.fold = 3.f;
+		controls.feedback = 0.5f;
+		controls.feedbackCv = 0.5f;
+		controls.shape = 0.5f;
+		controls.shapeCv = 0.5f;
+		controls.mix = 1.f;
+		controls.mixCv = -0.5f;
+		audio.sine(channels, 220, 5.f);
+		if(connected) {
+			audio.sweep(channels, 20, 1000, 5.f);
+			gain.sine(channels, 1, 5.f);
+			feedback.sine(channels, 2, 5.f);
+			shape.noise(channels, 5.f);
+			mix.sine(channels, 4, 5.f);
+			fold.sine(channels, 5, 2.f);
+		}
+	}
+	void process(int frame) {
+		RemainderKernel::Inputs in;
+		in.audio = audio.at(frame);
+		in.gain = gain.at(frame);
+		in.feedback = feedback.at(frame);
+		in.shape = shape.at(frame);
+		in.mix = mix.at(frame);
+		in.fold = fold.at(frame);
+		kernel.process(controls, in, out, channels);
+	}
+	float sink() {
+		return out[0];
+	}
+	template <typename TRecorder>
+	void digest(TRecorder &recorder) const {
+		recorder.add(out, channels);
+	}
+};
+
+struct RemainderFastBench : RemainderBench {
+	RemainderFastBench(int channels, bool connected) : RemainderBench(channels, connected) {
+		kernel.fastFold = true;
+	}
+};
+
+struct RemainderAdaaBench : RemainderBench {
+	RemainderAdaaBench(int channels, bool connected) : RemainderBench(channels, connected) {
+		kernel.antiAlias = true;
+	}
+};
+
+struct RemainderFastAdaaBench : RemainderBench {
+	RemainderFastAdaaBench(int channels, bool connected) : RemainderBench(channels, connected) {
+		kernel.fastFold = true;
+		kernel.antiAlias = true;
+	}
+};
+
+struct RemainderOversampleBench : RemainderBench {
+	RemainderOversampleBench(int channels, bool connected) : RemainderBench(channels, connected) {
+		kernel.oversample = 4;
+	}
+};
+
+struct RemainderStabilizeBench : RemainderBench {
+	RemainderStabilizeBench(int channels, bool connected) : RemainderBench(channels, connected) {
+		kernel.sampleRate = SAMPLE_RATE;
+		kernel.stabilize = true;
+		controls.feedback = 1.5f;
+	}
+};
+
+struct BCrushBench {
+	BCrushKernel kernel;
+	BCrushKernel::Controls controls;
+	TestSignal audio, sampleRate, clockHold, resolution, gain, shiftL, shiftR, bitAnd, bitOr, bitXor, bitNot;
+	float out[16] = {};
+	int channels;
+
+	BCrushBench(int channels, bool connected) : channels(channels) {
+		controls.sampleRate = 0.5f;
+		controls.resolution = 5.f;
+		audio.sine(channels, 220, 5.f);
+		if(connected) {
+			audio.sweep(channels, 20, 1000, 5.f);
+			sampleRate.sine(channels, 1, 2.f);
+			resolution.sine(channels, 2, 2.f);
+			gain.sine(channels, 3, 2.f, 5.f);
+			shiftL.sine(channels, 4, 10.f);
+			shiftR.sine(channels, 5, 10.f);
+			bitAnd.sine(channels, 6, 10.f);
+			bitOr.sine(channels, 7, 10.f);
+			bitXor.noise(channels, 10.f);
+			bitNot.pulse(channels, 1000);
+		}
+	}
+	void process(int frame) {
+		BCrushKernel::Inputs in;
+		in.audio = audio.at(frame);
+		in.sampleRate = sampleRate.at(frame);
+		in.clockHold = clockHold.at(frame);
+		in.resolution = resolution.at(frame);
+		in.gain = gain.at(frame);
+		in.shiftL = shiftL.at(frame);
+		in.shiftR = shiftR.at(frame);
+		in.bitAnd = bitAnd.at(frame);
+		in.bitOr = bitOr.at(frame);
+		in.bitXor = bitXor.at(frame);
+		in.bitNot = bitNot.at(frame);
+		if(kernel.isBlockStart())
+			kernel.prepare(controls, in);
+		if(kernel.tick(in, SAMPLE_RATE, channels))
+			kernel.crush(in, out, channels);
+		if(kernel.bandLimit)
+			kernel.render(out, channels);
+	}
+	float sink() {
+		return out[0];
+	}
+	template <typename TRecorder>
+	void digest(TRecorder &recorder) const {
+		recorder.add(out, channels);
+	}
+};
+
+struct BCrushBlepBench : BCrushBench {
+	BCrushBlepBench(int channels, bool connected) : BCrushBench(channels, connected) {
+		kernel.bandLimit = true;
+	}
+};
+
+struct ClockDivBench {
+	ClockDivKernel kernel;
+	TestSignal clock, reset, seq;
+	float out[ClockDivKernel::NUM_OUTPUTS][16] = {};
+	float *outs[ClockDivKernel::NUM_OUTPUTS];
+	int channels;
+	bool sequence = false;
+
+	ClockDivBench(int channels, bool connected) : channels(channels) {
+		clock.pulse(channels, 64);
+		if(connected) {
+			//resets land at different clock phases within the golden test's frames
+			reset.pulse(channels, 352);
+			seq.sine(channels, 10, 5.f);
+		}
+		for(int d = 0; d < ClockDivKernel::NUM_OUTPUTS; ++d)
+			outs[d] = out[d];
+	}
+	void process(int frame) {
+		ClockDivKernel::Inputs in;
+		in.clock = clock.at(frame);
+		in.reset = reset.at(frame);
+		in.seq = seq.at(frame);
+		kernel.process(sequence, in, outs, channels);
+	}
+	float sink() {
+		return out[0][0];
+	}
+	template <typename TRecorder>
+	void digest(TRecorder &recorder) const {
+		for(int d = 0; d < ClockDivKernel::NUM_OUTPUTS; ++d)
+			recorder.add(out[d], channels);
+	}
+};
+
+//custom ratios; long free running divisions on even outputs and multiplications on odd ones
+struct ClockDivRatioBench : ClockDivBench {
+	ClockDivRatioBench(int channels, bool connected) : ClockDivBench(channels, connected) {
+		kernel.cycle = false;
+		for(int d = 0; d < ClockDivKernel::NUM_OUTPUTS; ++d)
+			kernel.setRatio(d, (d % 2)? d + 1 : uint64_t(1) << (2 * d), d % 2);
+	}
+};
+
+//ratios past the 16 step cycle on odd outputs with the cycle on; a faster clock lets them
+//fire several times within the golden test's frames
+struct ClockDivCycleBench : ClockDivBench {
+	ClockDivCycleBench(int channels, bool connected) : ClockDivBench(channels, connected) {
+		clock.pulse(channels, 4);
+		for(int d = 0; d < ClockDivKernel::NUM_OUTPUTS; ++d)
+			kernel.setRatio(d, (d % 2)? 17 + 8 * d : d + 1, false);
+	}
+};
+
+struct ClockDivSequenceBench : ClockDivBench {
+	ClockDivSequenceBench(int channels, bool connected) : ClockDivBench(channels, connected) {
+		sequence = true;
+	}
+};
+
+struct ClockDivPreciseBench : ClockDivRatioBench {
+	ClockDivPreciseBench(int channels, bool connected) : ClockDivRatioBench(channels, connected) {
+		kernel.precise = true;
+	}
+};
+
+//clock heavy patch; many dividers following related clocks share a few cables
+struct ClockDivPatchBench {
+	static const int INSTANCES = 30;
+	static const int CLOCKS = 5;
+	ClockDivKernel kernels[INSTANCES];
+	TestSignal clocks[CLOCKS], reset, seq;
+	float out[INSTANCES][ClockDivKernel::NUM_OUTPUTS][16] = {};
+	float *outs[INSTANCES][ClockDivKernel::NUM_OUTPUTS];
+	int channels;
+
+	ClockDivPatchBench(int channels, bool connected) : channels(channels) {
+		for(int i = 0; i < CLOCKS; ++i)
+			clocks[i].pulse(channels, 16 << i);
+		if(connected) {
+			reset.pulse(channels, 2048);
+			seq.sine(channels, 10, 5.f);
+		}
+		for(int i = 0; i < INSTANCES; ++i) {
+			for(int d = 0; d < ClockDivKernel::NUM_OUTPUTS; ++d)
+				outs[i][d] = out[i][d];
+		}
+	}
+	void process(int frame) {
+		ClockDivKernel::Inputs in;
+		in.reset = reset.at(frame);
+		for(int i = 0; i < INSTANCES; ++i) {
+			in.clock = clocks[i % CLOCKS].at(frame);
+			//only some of the dividers have their output modulated
+			in.seq = (i % 3 == 0)? seq.at(frame) : Signal();
+			kernels[i].process(false, in, outs[i], channels);
+		}
+	}
+	float sink() {
+		return out[INSTANCES - 1][0][0];
+	}
+	template <typename TRecorder>
+	void digest(TRecorder &recorder) const {
+		for(int i = 0; i < INSTANCES; ++i) {
+			for(int d = 0; d < ClockDivKernel::NUM_OUTPUTS; ++d)
+				recorder.add(out[i][d], channels);
+		}
+	}
+};
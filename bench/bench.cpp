@@ -0,0 +1,229 @@
+//Headless benchmark of the DSP kernels; built by `make bench` without Rack or GUI libraries
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "Harness.hpp"
+
+static const int FRAMES = 1 << 18;
+//FNV-1a hash of the exact output bits; equal hashes mean a change kept the output bit for bit
+struct Fingerprint {
+	uint32_t hash = 2166136261u;
+	double sumSquares = 0.0;
+	uint64_t count = 0;
+
+	void add(const float *voltages, int channels) {
+		for(int c = 0; c < channels; ++c) {
+			uint32_t bits;
+			std::memcpy(&bits, &voltages[c], sizeof(bits));
+			for(int b = 0; b < 4; ++b) {
+				hash ^= (bits >> (8 * b)) & 0xff;
+				hash *= 16777619u;
+			}
+			sumSquares += voltages[c] * voltages[c];
+			++count;
+		}
+	}
+	//level of the output to compare within a tolerance when the bits are expected to change
+	double getRms() const {
+		return count? std::sqrt(sumSquares / count) : 0.0;
+	}
+};
+
+//keeps the optimizer from discarding kernel output
+static volatile float sinkValue;
+
+//instances divides the reported time so benches of whole patches show per module cost
+template <typename TBench>
+void run(const char *name, int instances = 1) {
+	const int channelCounts[] = {1, 4, 8, 16};
+	for(int channels : channelCounts) {
+		for(int connected = 0; connected < 2; ++connected) {
+			//the first period from a fresh state is fingerprinted before warming up the timing
+			TBench bench(channels, connected);
+			Fingerprint fingerprint;
+			for(int frame = 0; frame < PERIOD; ++frame) {
+				bench.process(frame);
+				bench.digest(fingerprint);
+			}
+
+			const auto start = std::chrono::steady_clock::now();
+			for(int frame = 0; frame < FRAMES; ++frame)
+				bench.process(frame);
+			const auto end = std::chrono::steady_clock::now();
+			sinkValue = bench.sink();
+
+			const double ns = std::chrono::duration<double, std::nano>(end - start).count() / FRAMES / instances;
+			std::printf("%-14s %2d  %-12s %10.2f %14.0f   %08x %9.4f\n", name, channels,
+				connected? "connected" : "disconnected", ns, 1e9 / ns, fingerprint.hash, fingerprint.getRms());
+		}
+	}
+}
+
+//timing of a multiplied ClockDiv output against the ideal subdivision of a clock whose
+//period is not a whole number of samples; the clock ramps 1 V per sample like a band limited edge
+static void measureJitter(bool precise) {
+	const double period = 441.37;
+	const int multiply = 4;
+	const double offset = 0.3;
+
+	ClockDivKernel kernel;
+	kernel.precise = precise;
+	kernel.setRatio(0, multiply, true);
+	float out[ClockDivKernel::NUM_OUTPUTS][16] = {};
+	float *outs[ClockDivKernel::NUM_OUTPUTS];
+	for(int d = 0; d < ClockDivKernel::NUM_OUTPUTS; ++d)
+		outs[d] = out[d];
+
+	double sum = 0.0, sumSquares = 0.0, minError = INFINITY, maxError = -INFINITY;
+	int pulses = 0;
+	float lastOut = 0.f;
+	for(int frame = 0; frame < FRAMES; ++frame) {
+		//continuous ramp sampled at this frame
+		const double phase = std::fmod(frame - offset + 1.0, period) - 1.0;
+		float clock = 0.f;
+		if(phase < period / 2)
+			clock = std::min(phase + 1.0, 10.0);
+
+		ClockDivKernel::Inputs in;
+		in.clock = Signal(&clock, 1);
+		kernel.process(false, in, outs, 1);
+
+		//skip the first clocks while the period is measured
+		if(out[0][0] > 0.f && lastOut <= 0.f && frame > 2 * period) {
+			const double spacing = period / multiply;
+			const double error = frame - (offset + std::round((frame - offset) / spacing) * spacing);
+			sum += error;
+			sumSquares += error * error;
+			minError = std::min(minError, error);
+			maxError = std::max(maxError, error);
+			++pulses;
+		}
+		lastOut = out[0][0];
+	}
+	const double mean = sum / pulses;
+	std::printf("%-14s %6d %10.3f %10.3f %10.3f\n", precise? "sub-sample" : "sample", pulses,
+		mean, std::sqrt(sumSquares / pulses - mean * mean), maxError - minError);
+}
+
+//inputs the fast fold is checked on
+enum FoldProbe {
+	//-40 to 40 V
+	FOLD_GRID,
+	//every half period edge and a few float steps around it
+	FOLD_EDGES,
+	//quotients from half to 64 times FAST_FOLD_LIMIT, where the exact quotients take over
+	FOLD_FAR,
+};
+
+//mismatches must have a quotient this close to an edge relative to the quotient, and an output
+//at most one signed fold period (two divisors) away plus the rounding of the output at that size
+static const double FOLD_EDGE_BOUND = 4.0 / (1 << 23);
+static const double FOLD_ERROR_BOUND = 2.0;
+
+//distance of x / d from the nearest whole or half period relative to the quotient
+static double foldEdgeDistance(float x, float divisor) {
+	const double u = 2.0 * x / divisor;
+	return std::fabs(u - std::round(u)) / std::max(std::fabs(u), 1.0);
+}
+
+//fast fold against the exact fold for a range of divisors; false when a mismatch breaks the bounds
+static bool measureFoldError(bool antiAlias, FoldProbe probe) {
+	const char *probeNames[] = {"grid", "edges", "far"};
+	const int inputs = 1 << 16;
+	long samples = 0, mismatches = 0, failures = 0;
+	double maxError = 0.0, maxEdgeDistance = 0.0;
+	for(int i = 0; i < 64; ++i) {
+		const float divisor = 0.02f + i * 0.157f;
+		const float_4 d = divisor;
+		const float_4 recip = 1.f / d;
+		float_4 in1 = 0.f;
+		for(int n = 0; n < inputs; n += 4) {
+			//the shape at both ends and in between
+			float_4 in;
+			for(int k = 0; k < 4; ++k) {
+				if(probe == FOLD_EDGES) {
+					const float edge = (int((n + k) / 8) - inputs / 16) * 0.5f * divisor;
+					in.s[k] = edge;
+					for(int step = 0; step < (n + k) % 8; ++step)
+						in.s[k] = std::nextafter(in.s[k], ((n + k) % 2)? INFINITY : -INFINITY);
+				}
+				else if(probe == FOLD_FAR) {
+					const float quotient = FAST_FOLD_LIMIT * std::exp2(-1.f + 7.f * (n + k) / inputs);
+					in.s[k] = (((n + k) % 2)? quotient : -quotient) * divisor;
+				}
+				else {
+					in.s[k] = -40.f + 80.f * (n + k) / inputs;
+				}
+			}
+			const float_4 shape(0.f, 1.f, 0.5f, 0.f);
+			const float_4 exact = antiAlias? RemainderKernel::foldAdaa(in, in1, d, shape) : RemainderKernel::fold(in, d, shape);
+			const float_4 fast = antiAlias? RemainderKernel::foldAdaa(in, in1, d, shape, &recip) : RemainderKernel::fold(in, d, shape, &recip);
+			for(int k = 0; k < 4; ++k) {
+				++samples;
+				if(exact[k] == fast[k])
+					continue;
+				++mismatches;
+				const double error = std::fabs(double(exact[k]) - fast[k]) / divisor;
+				maxError = std::max(maxError, error);
+				//the anti-aliased fold reads the previous input and the midpoint as well
+				double edgeDistance = foldEdgeDistance(in[k], divisor);
+				if(antiAlias) {
+					edgeDistance = std::min(edgeDistance, foldEdgeDistance(in1[k], divisor));
+					edgeDistance = std::min(edgeDistance, foldEdgeDistance(0.5f * (in[k] + in1[k]), divisor));
+				}
+				maxEdgeDistance = std::max(maxEdgeDistance, edgeDistance);
+				const double rounding = std::ldexp(std::fabs(double(in[k])) / divisor, -21);
+				if(edgeDistance > FOLD_EDGE_BOUND || error > FOLD_ERROR_BOUND + rounding)
+					++failures;
+			}
+			in1 = in;
+		}
+	}
+	std::printf("%-6s %-7s %10ld %10ld %10ld %14.3f %14.2e\n", antiAlias? "adaa" : "plain", probeNames[probe],
+		samples, mismatches, failures, maxError, maxEdgeDistance);
+	return failures == 0;
+}
+
+int main() {
+	std::printf("%-14s %2s  %-12s %10s %14s   %8s %9s\n", "module", "ch", "cv", "ns/sample", "samples/sec", "output", "rms");
+	run<BCrushBench>("BCrush");
+	run<BCrushBlepBench>("BCrushBlep");
+	run<ClipBench>("Clip");
+	run<ClipMonoCvBench>("ClipMonoCv");
+	run<ClipBandsBench>("Clip3Band");
+	run<ClipLookaheadBench>("ClipLookahead");
+	run<ClipLookaheadDragBench>("ClipLookaheadDrag");
+	run<ClipAdaaBench>("ClipAdaa");
+	run<RemainderBench>("Remainder");
+	run<RemainderFastBench>("RemainderFast");
+	run<RemainderAdaaBench>("RemainderAdaa");
+	run<RemainderFastAdaaBench>("RemainderFastAdaa");
+	run<RemainderOversampleBench>("Remainder4x");
+	run<RemainderStabilizeBench>("RemainderStable");
+	run<ClockDivBench>("ClockDiv");
+	run<ClockDivRatioBench>("ClockDivRatio");
+	run<ClockDivCycleBench>("ClockDivCycle");
+	run<ClockDivSequenceBench>("ClockDivSeq");
+	run<ClockDivPreciseBench>("ClockDivPrecise");
+	run<ClockDivPatchBench>("ClockDivx30", ClockDivPatchBench::INSTANCES);
+
+	std::printf("\nClockDiv x4 gate timing error in samples\n");
+	std::printf("%-14s %6s %10s %10s %10s\n", "timing", "pulses", "mean", "rms jitter", "peak-peak");
+	measureJitter(false);
+	measureJitter(true);
+
+	std::printf("\nRemainder fast fold against exact fold; errors in periods, edge distance relative to the quotient\n");
+	std::printf("%-6s %-7s %10s %10s %10s %14s %14s\n", "fold", "inputs", "samples", "mismatches", "failures", "max error", "edge distance");
+	bool passed = true;
+	for(int antiAlias = 0; antiAlias < 2; ++antiAlias) {
+		passed &= measureFoldError(antiAlias, FOLD_GRID);
+		passed &= measureFoldError(antiAlias, FOLD_EDGES);
+		passed &= measureFoldError(antiAlias, FOLD_FAR);
+	}
+	if(!passed)
+		std::printf("fast fold mismatches outside the bounds\n");
+	return passed? 0 : 1;
+}
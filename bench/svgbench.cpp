@@ -0,0 +1,139 @@
+//Construction time of the component widgets of a patch of many modules: the plugin's widgets,
+//which take their SVGs from the shared registry, against copies of the widgets as they were
+//before, which built an asset path and called Svg::load for every frame.
+//Built by `make svgbench` from the plugin sources and libRack; run it from the plugin directory.
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "../src/aridacity.hpp"
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::shared_ptr<Svg> loadComponent(const char *file) {
+	return Svg::load(asset::plugin(pluginInstance, std::string("res/ComponentLibrary/") + file));
+}
+
+//the component widgets before the registry
+struct LegacySmallWhiteSwitch : app::SvgSwitch {
+	LegacySmallWhiteSwitch() {
+		addFrame(loadComponent("smallWhiteSwitch0.svg"));
+		addFrame(loadComponent("smallWhiteSwitch1.svg"));
+	}
+};
+struct LegacySmallWhiteKnob : RoundKnob {
+	LegacySmallWhiteKnob() {
+		setSvg(loadComponent("smallWhiteKnob.svg"));
+	}
+};
+struct LegacyWhiteKnob : RoundKnob {
+	LegacyWhiteKnob() {
+		setSvg(loadComponent("whiteKnob.svg"));
+	}
+};
+struct LegacySmallWhitePort : SVGPort {
+	LegacySmallWhitePort() {
+		setSvg(loadComponent("smallWhitePort.svg"));
+	}
+};
+struct LegacySmallBlackPort : SVGPort {
+	LegacySmallBlackPort() {
+		setSvg(loadComponent("smallBlackPort.svg"));
+	}
+};
+
+struct SharedComponents {
+	typedef SmallWhiteSwitch Switch;
+	typedef SmallWhiteKnob SmallKnob;
+	typedef WhiteKnob Knob;
+	typedef SmallWhitePort Input;
+	typedef SmallBlackPort Output;
+};
+struct LegacyComponents {
+	typedef LegacySmallWhiteSwitch Switch;
+	typedef LegacySmallWhiteKnob SmallKnob;
+	typedef LegacyWhiteKnob Knob;
+	typedef LegacySmallWhitePort Input;
+	typedef LegacySmallBlackPort Output;
+};
+
+//component widgets on each panel
+struct PanelComponents {
+	const char *name;
+	int switches;
+	int smallKnobs;
+	int knobs;
+	int inputs;
+	int outputs;
+};
+static const PanelComponents panels[] = {
+	{"ClockDiv", 1, 0, 0, 3, 16},
+	{"bCrush", 0, 0, 2, 11, 1},
+	{"Clip", 2, 0, 3, 6, 1},
+	{"Remainder", 0, 4, 5, 6, 1},
+};
+static const int NUM_PANELS = sizeof(panels) / sizeof(panels[0]);
+
+//creates the component widgets of the given number of modules, cycling through the panels, without
+//a module like the module browser does
+template <typename TComponents>
+static double createPanels(int modules, std::vector<widget::Widget*> &widgets) {
+	const auto start = std::chrono::steady_clock::now();
+	for(int m = 0; m < modules; ++m) {
+		const PanelComponents &panel = panels[m % NUM_PANELS];
+		for(int i = 0; i < panel.switches; ++i)
+			widgets.push_back(createParam<typename TComponents::Switch>(Vec(), nullptr, i));
+		for(int i = 0; i < panel.smallKnobs; ++i)
+			widgets.push_back(createParam<typename TComponents::SmallKnob>(Vec(), nullptr, i));
+		for(int i = 0; i < panel.knobs; ++i)
+			widgets.push_back(createParam<typename TComponents::Knob>(Vec(), nullptr, i));
+		for(int i = 0; i < panel.inputs; ++i)
+			widgets.push_back(createInput<typename TComponents::Input>(Vec(), nullptr, i));
+		for(int i = 0; i < panel.outputs; ++i)
+			widgets.push_back(createOutput<typename TComponents::Output>(Vec(), nullptr, i));
+	}
+	return elapsedMs(start);
+}
+
+//closing the patch; each Svg::load cache entry expires with the last widget holding it
+static void deleteWidgets(std::vector<widget::Widget*> &widgets) {
+	for(widget::Widget *w : widgets)
+		delete w;
+	widgets.clear();
+}
+
+int main() {
+	//log to stderr without the Rack user folder
+	settings::devMode = true;
+	logger::init();
+
+	Plugin plugin;
+	plugin.path = system::getWorkingDirectory();
+	pluginInstance = &plugin;
+	componentSvgs.init(&plugin);
+
+	std::vector<widget::Widget*> widgets;
+
+	//the first panel of each kind parses its SVGs on either path; the registry keeps them afterwards
+	const double coldLegacy = createPanels<LegacyComponents>(NUM_PANELS, widgets);
+	deleteWidgets(widgets);
+	const double coldShared = createPanels<SharedComponents>(NUM_PANELS, widgets);
+	deleteWidgets(widgets);
+	std::printf("first %d panels: %.3f ms per widget load, %.3f ms shared\n\n", NUM_PANELS, coldLegacy, coldShared);
+
+	//each patch is built into an empty rack, so the per widget path parses every file again once
+	std::printf("%8s %10s %16s %16s %10s\n", "modules", "widgets", "per widget ms", "shared ms", "speedup");
+	const int moduleCounts[] = {100, 1000, 10000};
+	for(int modules : moduleCounts) {
+		const double legacy = createPanels<LegacyComponents>(modules, widgets);
+		deleteWidgets(widgets);
+		const double shared = createPanels<SharedComponents>(modules, widgets);
+		const int count = widgets.size();
+		deleteWidgets(widgets);
+		std::printf("%8d %10d %16.3f %16.3f %9.1fx\n", modules, count, legacy, shared, legacy / shared);
+	}
+
+	logger::destroy();
+	return 0;
+}
@@ -1,6 +1,7 @@
 #include "aridacity.hpp"
+#include "kernel/BCrushKernel.hpp"
 
-struct BCrush : Module {
+struct BCrush : ChainModule {
 	enum ParamIds {
 		SAMPLE_RATE_PARAM,
 		AMP_RES_PARAM,
@@ -25,20 +26,24 @@ struct BCrush : Module {
 		NUM_OUTPUTS
 	};
 
-	dsp::SchmittTrigger holdTrigger;
-
-	const float maxRes = 12.8f;
-	float curSampleTime = 0.f;
+	BCrushKernel kernel;
+	Profiler profiler;
 
 	BCrush();
-	void process(const ProcessArgs &args) override;
+	void processAudio(const ProcessArgs &args, Signal audio) override;
+	int getLatency() override {
+		return kernel.getLatency();
+	}
 	void onSampleRateChange(const SampleRateChangeEvent& e) override;
+
+	json_t* dataToJson() override;
+	void dataFromJson(json_t *rootJ) override;
 };
 
 BCrush::BCrush() {
 	config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS);
 	configParam(BCrush::SAMPLE_RATE_PARAM, 0.f, 1.f, 1.f, "Sample rate", "Hz", 0.f, APP->engine->getSampleRate());
-	configParam(BCrush::AMP_RES_PARAM, 0.f, 10.f, 10.f, "Resolution", "", 0.f, maxRes);
+	configParam(BCrush::AMP_RES_PARAM, 0.f, 10.f, 10.f, "Resolution", "", 0.f, kernel.maxRes);
 	configBypass(BCrush::AUDIO_INPUT, BCrush::AUDIO_OUTPUT);
 
 	configInput(BCrush::AUDIO_INPUT, "Audio");
@@ -53,67 +58,99 @@ BCrush::BCrush() {
 	configInput(BCrush::XOR_INPUT, "XOR logic");
 	configInput(BCrush::NOT_INPUT, "NOT logic");
 	configOutput(BCrush::AUDIO_OUTPUT, "Audio");
+	profiler.fastPathName = "Held samples";
+	chainInput = AUDIO_INPUT;
+	chainOutput = AUDIO_OUTPUT;
 }
 
-void BCrush::process(const ProcessArgs &args) {
-	if(inputs[CLOCK_HOLD_INPUT].isConnected()) {
-		//update output on clock input
-		if(!holdTrigger.process(inputs[CLOCK_HOLD_INPUT].getVoltage()))
-			return;
+void BCrush::processAudio(const ProcessArgs &args, Signal audio) {
+	Profiler::Scope scope(profiler);
+
+	BCrushKernel::Inputs in;
+	in.audio = audio;
+	in.sampleRate = getSignal(inputs[SAMPLE_RATE_INPUT]);
+	in.clockHold = getSignal(inputs[CLOCK_HOLD_INPUT]);
+	in.resolution = getSignal(inputs[AMP_RES_INPUT]);
+	in.gain = getSignal(inputs[GAIN_INPUT]);
+	in.shiftL = getSignal(inputs[SHIFTL_INPUT]);
+	in.shiftR = getSignal(inputs[SHIFTR_INPUT]);
+	in.bitAnd = getSignal(inputs[AND_INPUT]);
+	in.bitOr = getSignal(inputs[OR_INPUT]);
+	in.bitXor = getSignal(inputs[XOR_INPUT]);
+	in.bitNot = getSignal(inputs[NOT_INPUT]);
+
+	//read knobs and patched inputs once per block
+	if(kernel.isBlockStart()) {
+		BCrushKernel::Controls controls;
+		controls.sampleRate = params[SAMPLE_RATE_PARAM].getValue();
+		controls.resolution = params[AMP_RES_PARAM].getValue();
+		kernel.prepare(controls, in);
 	}
-	else {
-		//add time according to sample rate
-		curSampleTime += clamp( (params[SAMPLE_RATE_PARAM].getValue() +
-					(inputs[SAMPLE_RATE_INPUT].getVoltage() / 10.f)) * args.sampleRate,
-					100.f, args.sampleRate );
-
-		//update output if enough time has passed
-		if(curSampleTime >= args.sampleRate) {
-			curSampleTime -= args.sampleRate;
-		}
-		//return to keep output sample
-		else	return;
+
+	const int channels = audio.channels;
+	const bool updated = kernel.tick(in, args.sampleRate, channels);
+
+	//band limited steps change the output on every frame
+	if(kernel.bandLimit) {
+		outputs[AUDIO_OUTPUT].setChannels(channels);
+		if(updated)
+			kernel.crush(in, outputs[AUDIO_OUTPUT].getVoltages(), channels);
+		else
+			profiler.countFastPath();
+		kernel.render(outputs[AUDIO_OUTPUT].getVoltages(), channels);
+		return;
 	}
-	//process input signal channels
-	const float resParam = params[AMP_RES_PARAM].getValue();
-	const int channels = inputs[AUDIO_INPUT].getChannels();
-	outputs[AUDIO_OUTPUT].setChannels(channels);
 
-	for(int c = 0; c < channels; ++c) {
-		//limit resolution to avoid divide by zero
-		float ampRes = std::max( (resParam + inputs[AMP_RES_INPUT].getVoltage(c)) * maxRes, 1.f);
-
-		float audi = inputs[AUDIO_INPUT].getVoltage(c) / 5.f;
-
-		if(inputs[GAIN_INPUT].isConnected())
-			audi *= (inputs[GAIN_INPUT].getVoltage(c) / 5.f);
-
-		//quantize output according to resolution input
-		int quant = audi * ampRes;
-		//apply bit operations and quantize all inputs
-		if(inputs[SHIFTL_INPUT].isConnected())
-			quant <<= static_cast<int>( fabs(inputs[SHIFTL_INPUT].getVoltage(c) / 100.f) * ampRes );
-		if(inputs[SHIFTR_INPUT].isConnected())
-			quant >>= static_cast<int>( (inputs[SHIFTR_INPUT].getVoltage(c) / 100.f) * ampRes );
-		if(inputs[AND_INPUT].isConnected())
-			quant &= static_cast<int>( (inputs[AND_INPUT].getVoltage(c) / 10.f) * ampRes );
-		if(inputs[OR_INPUT].isConnected())
-			quant |= static_cast<int>( (inputs[OR_INPUT].getVoltage(c) / 10.f) * ampRes );
-		if(inputs[XOR_INPUT].isConnected())
-			quant ^= static_cast<int>( (inputs[XOR_INPUT].getVoltage(c) / 10.f) * ampRes );
-		if(inputs[NOT_INPUT].isConnected() && fabs(inputs[NOT_INPUT].getVoltage(c)) > 1.f)
-			quant = ~quant;
-			//quant %= static_cast<int>( (inputs[NOT_INPUT].getVoltage(c) / 10.f) * ampRes );
-
-		//descale output
-		outputs[AUDIO_OUTPUT].setVoltage((quant / ampRes) * 5.f, c);
+	//return when every channel keeps its output sample
+	if(!updated) {
+		profiler.countFastPath();
+		return;
 	}
+
+	//process input signal channels
+	outputs[AUDIO_OUTPUT].setChannels(channels);
+	kernel.crush(in, outputs[AUDIO_OUTPUT].getVoltages(), channels);
 }
 
 void BCrush::onSampleRateChange(const SampleRateChangeEvent& e) {
 	paramQuantities[SAMPLE_RATE_PARAM]->displayMultiplier = e.sampleRate;
 }
 
+json_t* BCrush::dataToJson() {
+	json_t *rootJ = json_object();
+
+	json_object_set_new(rootJ, "bandLimit", json_boolean(kernel.bandLimit));
+	json_object_set_new(rootJ, "chain", json_boolean(chain));
+	return rootJ;
+}
+void BCrush::dataFromJson(json_t *rootJ) {
+	json_t *bandLimitJ = json_object_get(rootJ, "bandLimit");
+	if(bandLimitJ)
+		kernel.bandLimit = json_boolean_value(bandLimitJ);
+
+	json_t *chainJ = json_object_get(rootJ, "chain");
+	if(chainJ)
+		chain = json_boolean_value(chainJ);
+}
+
+struct BandLimitItem : MenuItem {
+	BCrush *module;
+	void onAction(const event::Action &e) override {
+		module->kernel.bandLimit ^= true;
+	}
+	void step() override {
+		rightText = CHECKMARK(module->kernel.bandLimit);
+	}
+};
+
+struct BCrushLatencyLabel : MenuLabel {
+	BCrush *module;
+	void step() override {
+		text = string::f("Latency: %d samples", module->kernel.getLatency());
+		MenuLabel::step();
+	}
+};
+
 struct BCrushWidget : ModuleWidget {
 	BCrushWidget(BCrush *module) {
 		setModule(module);
@@ -140,6 +177,22 @@ struct BCrushWidget : ModuleWidget {
 		addInput(createInput<SmallWhitePort>(Vec(4, 330), module, BCrush::AUDIO_INPUT));
 		addOutput(createOutput<SmallBlackPort>(Vec(35, 330), module, BCrush::AUDIO_OUTPUT));
 	}
+
+	void appendContextMenu(Menu *menu) override {
+		menu->addChild(new MenuEntry);
+
+		BCrush *module = dynamic_cast<BCrush*>(this->module);
+		assert(module);
+
+		menu->addChild(construct<BandLimitItem>(&MenuItem::text, "Band-limited holds", &BandLimitItem::module, module));
+		menu->addChild(construct<BCrushLatencyLabel>(&BCrushLatencyLabel::module, module));
+
+		appendChainMenu(menu, module);
+
+		appendTelemetryMenu(menu, &module->telemetry);
+
+		appendProfilerMenu(menu, module, &module->profiler);
+	}
 };
 
 Model *modelBCrush = createModel<BCrush, BCrushWidget>("BCrush");
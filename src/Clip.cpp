@@ -1,6 +1,7 @@
 #include "aridacity.hpp"
+#include "kernel/ClipKernel.hpp"
 
-struct Clip : Module {
+struct Clip : ChainModule {
 	enum ParamIds {
 		PULL_PARAM,
 		ENABLE_LIMIT_PARAM,
@@ -22,9 +23,27 @@ struct Clip : Module {
 		AUDIO_OUTPUT,
 		NUM_OUTPUTS
 	};
+	//knobs ramped by the smoother
+	enum SmoothIds {
+		SMOOTH_GAIN,
+		SMOOTH_PUSH,
+		SMOOTH_LIMIT,
+		NUM_SMOOTHED
+	};
+
+	ClipKernel kernel;
+	ControlSmoother<NUM_SMOOTHED> smoother;
+	Profiler profiler;
 
 	Clip();
-	void process(const ProcessArgs &args) override;
+	void onSampleRateChange(const SampleRateChangeEvent &e) override;
+	void processAudio(const ProcessArgs &args, Signal audio) override;
+	int getLatency() override {
+		return kernel.getLatency();
+	}
+
+	json_t* dataToJson() override;
+	void dataFromJson(json_t *rootJ) override;
 };
 
 Clip::Clip() {
@@ -42,42 +61,295 @@ Clip::Clip() {
 	configInput(Clip::LIMIT_SIZ_INPUT, "Limit");
 	configInput(Clip::LIMIT_POS_INPUT, "Limit Position");
 	configOutput(Clip::AUDIO_OUTPUT, "Audio");
+
+	kernel.setSampleRate(APP->engine->getSampleRate());
+	chainInput = AUDIO_INPUT;
+	chainOutput = AUDIO_OUTPUT;
+}
+
+void Clip::onSampleRateChange(const SampleRateChangeEvent &e) {
+	kernel.setSampleRate(e.sampleRate);
 }
 
-void Clip::process(const ProcessArgs &args) {
-	const int channels = inputs[AUDIO_INPUT].getChannels();
+void Clip::processAudio(const ProcessArgs &args, Signal audio) {
+	Profiler::Scope scope(profiler);
+
+	const int channels = audio.channels;
 	outputs[AUDIO_OUTPUT].setChannels(channels);
 
+	//knobs are smoothed; switches take effect immediately
+	if(smoother.isReadFrame()) {
+		smoother.set(SMOOTH_GAIN, params[GAIN_PARAM].getValue());
+		smoother.set(SMOOTH_PUSH, params[PUSH_PARAM].getValue());
+		smoother.set(SMOOTH_LIMIT, params[LIMIT_PARAM].getValue());
+	}
+	smoother.process();
 
-	for(int c = 0; c < channels; ++c) {
-		const float pushSiz = params[PUSH_PARAM].getValue() + (inputs[PUSH_SIZ_INPUT].getVoltage(c) / 10.f);
-		const float pushCent = inputs[PUSH_POS_INPUT].getVoltage(c) / 5.f;
-		//add center offset
-		const float pushHi = pushCent + pushSiz;
-		const float pushLo = pushCent - pushSiz;
+	//parameters are shared by all channels
+	ClipKernel::Controls controls;
+	controls.gain = smoother.get(SMOOTH_GAIN);
+	controls.push = smoother.get(SMOOTH_PUSH);
+	controls.limit = smoother.get(SMOOTH_LIMIT);
+	controls.pull = params[PULL_PARAM].getValue() >= 1.f;
+	controls.enableLimit = params[ENABLE_LIMIT_PARAM].getValue() >= 1.f;
 
-		const float limit = params[LIMIT_PARAM].getValue() + (inputs[LIMIT_SIZ_INPUT].getVoltage(c) / 10.f);
-		const float limCenter = inputs[LIMIT_POS_INPUT].getVoltage(c) / 5.f;
+	ClipKernel::Inputs in;
+	in.audio = audio;
+	in.gain = getSignal(inputs[GAIN_INPUT]);
+	in.pushSize = getSignal(inputs[PUSH_SIZ_INPUT]);
+	in.pushPos = getSignal(inputs[PUSH_POS_INPUT]);
+	in.limitSize = getSignal(inputs[LIMIT_SIZ_INPUT]);
+	in.limitPos = getSignal(inputs[LIMIT_POS_INPUT]);
 
-		float audi = inputs[AUDIO_INPUT].getVoltage(c) / 5.f;
+	kernel.process(controls, in, outputs[AUDIO_OUTPUT].getVoltages(), channels);
+}
 
-		//add gain
-		audi *= params[GAIN_PARAM].getValue() + (inputs[GAIN_INPUT].getVoltage(c) / 10.f);
+json_t* Clip::dataToJson() {
+	json_t *rootJ = json_object();
 
-		//push inside if in range
-		if(audi < pushHi && audi > pushLo) {
-			audi = (params[PULL_PARAM].getValue() >= 1.f) ? 0.f :
-				(audi > 0.f? pushHi : pushLo);
-		}
+	json_object_set_new(rootJ, "antiAlias", json_boolean(kernel.antiAlias));
+	json_object_set_new(rootJ, "smoothing", json_boolean(smoother.enabled));
+	json_object_set_new(rootJ, "bands", json_integer(kernel.bands));
 
-		//clip limit outside 
-		if(params[ENABLE_LIMIT_PARAM].getValue() >= 1.f) {
-			audi = clamp(audi, limCenter-limit, limCenter+limit);
-		}
-		outputs[AUDIO_OUTPUT].setVoltage(audi * 5.f, c);
+	json_t *crossoversJ = json_array();
+	for(int j = 0; j < MAX_BANDS - 1; ++j)
+		json_array_append_new(crossoversJ, json_real(kernel.crossover[j]));
+	json_object_set_new(rootJ, "crossovers", crossoversJ);
+
+	json_t *bandPushJ = json_array();
+	json_t *bandLimitJ = json_array();
+	for(int b = 0; b < MAX_BANDS; ++b) {
+		json_array_append_new(bandPushJ, json_real(kernel.bandPush[b]));
+		json_array_append_new(bandLimitJ, json_real(kernel.bandLimit[b]));
+	}
+	json_object_set_new(rootJ, "bandPush", bandPushJ);
+	json_object_set_new(rootJ, "bandLimit", bandLimitJ);
+
+	json_object_set_new(rootJ, "lookahead", json_boolean(kernel.lookahead));
+	json_object_set_new(rootJ, "lookaheadMs", json_real(kernel.limiter.lookahead));
+	json_object_set_new(rootJ, "chain", json_boolean(chain));
+	return rootJ;
+}
+void Clip::dataFromJson(json_t *rootJ) {
+	json_t *antiAliasJ = json_object_get(rootJ, "antiAlias");
+	if(antiAliasJ)
+		kernel.antiAlias = json_boolean_value(antiAliasJ);
+
+	json_t *smoothingJ = json_object_get(rootJ, "smoothing");
+	if(smoothingJ)
+		smoother.enabled = json_boolean_value(smoothingJ);
+
+	json_t *bandsJ = json_object_get(rootJ, "bands");
+	if(bandsJ)
+		kernel.bands = clamp((int) json_integer_value(bandsJ), 1, MAX_BANDS);
+
+	json_t *crossoversJ = json_object_get(rootJ, "crossovers");
+	if(crossoversJ) {
+		for(int j = 0; j < MAX_BANDS - 1 && j < (int) json_array_size(crossoversJ); ++j)
+			kernel.crossover[j] = json_number_value(json_array_get(crossoversJ, j));
+	}
+
+	json_t *bandPushJ = json_object_get(rootJ, "bandPush");
+	if(bandPushJ) {
+		for(int b = 0; b < MAX_BANDS && b < (int) json_array_size(bandPushJ); ++b)
+			kernel.bandPush[b] = json_number_value(json_array_get(bandPushJ, b));
 	}
+
+	json_t *bandLimitJ = json_object_get(rootJ, "bandLimit");
+	if(bandLimitJ) {
+		for(int b = 0; b < MAX_BANDS && b < (int) json_array_size(bandLimitJ); ++b)
+			kernel.bandLimit[b] = json_number_value(json_array_get(bandLimitJ, b));
+	}
+
+	json_t *lookaheadJ = json_object_get(rootJ, "lookahead");
+	if(lookaheadJ)
+		kernel.lookahead = json_boolean_value(lookaheadJ);
+
+	json_t *lookaheadMsJ = json_object_get(rootJ, "lookaheadMs");
+	if(lookaheadMsJ)
+		kernel.limiter.lookahead = clamp((float) json_number_value(lookaheadMsJ), MIN_LOOKAHEAD_MS, MAX_LOOKAHEAD_MS);
+
+	json_t *chainJ = json_object_get(rootJ, "chain");
+	if(chainJ)
+		chain = json_boolean_value(chainJ);
 }
 
+struct ClipAntiAliasItem : MenuItem {
+	Clip *module;
+	void onAction(const event::Action &e) override {
+		module->kernel.antiAlias ^= true;
+	}
+	void step() override {
+		rightText = CHECKMARK(module->kernel.antiAlias);
+	}
+};
+
+struct ClipSmoothingItem : MenuItem {
+	Clip *module;
+	void onAction(const event::Action &e) override {
+		module->smoother.enabled ^= true;
+	}
+	void step() override {
+		rightText = CHECKMARK(module->smoother.enabled);
+	}
+};
+
+struct BandsItem : MenuItem {
+	Clip *module;
+	int bands;
+	void onAction(const event::Action &e) override {
+		module->kernel.bands = bands;
+	}
+	void step() override {
+		rightText = CHECKMARK(module->kernel.bands == bands);
+	}
+};
+
+//crossover frequency on a log scale from 20 Hz to 20 kHz
+struct CrossoverQuantity : Quantity {
+	Clip *module;
+	int crossover;
+	void setValue(float value) override {
+		module->kernel.crossover[crossover] = std::pow(2.f, clamp(value, getMinValue(), getMaxValue()));
+	}
+	float getValue() override {
+		return std::log2(module->kernel.crossover[crossover]);
+	}
+	float getMinValue() override {
+		return std::log2(20.f);
+	}
+	float getMaxValue() override {
+		return std::log2(20000.f);
+	}
+	float getDefaultValue() override {
+		return std::log2(DEFAULT_CROSSOVERS[crossover]);
+	}
+	float getDisplayValue() override {
+		return module->kernel.crossover[crossover];
+	}
+	void setDisplayValue(float displayValue) override {
+		setValue(std::log2(std::max(displayValue, 1.f)));
+	}
+	int getDisplayPrecision() override {
+		return 4;
+	}
+	std::string getLabel() override {
+		return string::f("Crossover %d", crossover + 1);
+	}
+	std::string getUnit() override {
+		return " Hz";
+	}
+};
+
+//push or limit size of one band relative to the knobs and CV
+struct BandScaleQuantity : Quantity {
+	float *scale;
+	std::string label;
+	void setValue(float value) override {
+		*scale = clamp(value, getMinValue(), getMaxValue());
+	}
+	float getValue() override {
+		return *scale;
+	}
+	float getMaxValue() override {
+		return 2.f;
+	}
+	float getDefaultValue() override {
+		return 1.f;
+	}
+	float getDisplayValue() override {
+		return *scale * 100.f;
+	}
+	void setDisplayValue(float displayValue) override {
+		setValue(displayValue / 100.f);
+	}
+	int getDisplayPrecision() override {
+		return 3;
+	}
+	std::string getLabel() override {
+		return label;
+	}
+	std::string getUnit() override {
+		return "%";
+	}
+};
+
+struct MenuSlider : ui::Slider {
+	MenuSlider(Quantity *quantity) {
+		this->quantity = quantity;
+		box.size.x = 200.f;
+	}
+	~MenuSlider() {
+		delete quantity;
+	}
+};
+
+struct BandSettingsItem : MenuItem {
+	Clip *module;
+	Menu *createChildMenu() override {
+		Menu *menu = new Menu;
+		const int bands = module->kernel.bands;
+		for(int j = 0; j < bands - 1; ++j)
+			menu->addChild(new MenuSlider(construct<CrossoverQuantity>(&CrossoverQuantity::module, module, &CrossoverQuantity::crossover, j)));
+		for(int b = 0; b < bands; ++b) {
+			menu->addChild(new MenuSlider(construct<BandScaleQuantity>(&BandScaleQuantity::scale, &module->kernel.bandPush[b], &BandScaleQuantity::label, string::f("Band %d push", b + 1))));
+			menu->addChild(new MenuSlider(construct<BandScaleQuantity>(&BandScaleQuantity::scale, &module->kernel.bandLimit[b], &BandScaleQuantity::label, string::f("Band %d limit", b + 1))));
+		}
+		return menu;
+	}
+	void step() override {
+		disabled = module->kernel.bands <= 1;
+		rightText = RIGHT_ARROW;
+		MenuItem::step();
+	}
+};
+
+struct LookaheadItem : MenuItem {
+	Clip *module;
+	void onAction(const event::Action &e) override {
+		module->kernel.lookahead ^= true;
+	}
+	void step() override {
+		rightText = CHECKMARK(module->kernel.lookahead);
+	}
+};
+
+struct LookaheadQuantity : Quantity {
+	Clip *module;
+	void setValue(float value) override {
+		module->kernel.limiter.lookahead = clamp(value, getMinValue(), getMaxValue());
+	}
+	float getValue() override {
+		return module->kernel.limiter.lookahead;
+	}
+	float getMinValue() override {
+		return MIN_LOOKAHEAD_MS;
+	}
+	float getMaxValue() override {
+		return MAX_LOOKAHEAD_MS;
+	}
+	float getDefaultValue() override {
+		return DEFAULT_LOOKAHEAD_MS;
+	}
+	int getDisplayPrecision() override {
+		return 2;
+	}
+	std::string getLabel() override {
+		return "Lookahead";
+	}
+	std::string getUnit() override {
+		return " ms";
+	}
+};
+
+struct ClipLatencyLabel : MenuLabel {
+	Clip *module;
+	void step() override {
+		text = string::f("Latency: %d samples", module->kernel.getLatency());
+		MenuLabel::step();
+	}
+};
+
 struct ClipWidget : ModuleWidget {
 	ClipWidget(Clip *module) {
 		setModule(module);
@@ -101,6 +373,33 @@ struct ClipWidget : ModuleWidget {
 		addInput(createInput<SmallWhitePort>(Vec( 4, 330), module, Clip::AUDIO_INPUT));
 		addOutput(createOutput<SmallBlackPort>(Vec(35, 330), module, Clip::AUDIO_OUTPUT));
 	}
+
+	void appendContextMenu(Menu *menu) override {
+		menu->addChild(new MenuEntry);
+
+		Clip *module = dynamic_cast<Clip*>(this->module);
+		assert(module);
+
+		menu->addChild(construct<ClipAntiAliasItem>(&MenuItem::text, "Anti-aliasing (ADAA)", &ClipAntiAliasItem::module, module));
+		menu->addChild(construct<ClipSmoothingItem>(&MenuItem::text, "Smooth knob changes", &ClipSmoothingItem::module, module));
+
+		menu->addChild(construct<MenuLabel>(&MenuLabel::text, "Bands"));
+		menu->addChild(construct<BandsItem>(&MenuItem::text, "Off", &BandsItem::module, module, &BandsItem::bands, 1));
+		menu->addChild(construct<BandsItem>(&MenuItem::text, "2", &BandsItem::module, module, &BandsItem::bands, 2));
+		menu->addChild(construct<BandsItem>(&MenuItem::text, "3", &BandsItem::module, module, &BandsItem::bands, 3));
+		menu->addChild(construct<BandsItem>(&MenuItem::text, "4", &BandsItem::module, module, &BandsItem::bands, 4));
+		menu->addChild(construct<BandSettingsItem>(&MenuItem::text, "Band settings", &BandSettingsItem::module, module));
+
+		menu->addChild(construct<LookaheadItem>(&MenuItem::text, "Lookahead true peak limit", &LookaheadItem::module, module));
+		menu->addChild(new MenuSlider(construct<LookaheadQuantity>(&LookaheadQuantity::module, module)));
+		menu->addChild(construct<ClipLatencyLabel>(&ClipLatencyLabel::module, module));
+
+		appendChainMenu(menu, module);
+
+		appendTelemetryMenu(menu, &module->telemetry);
+
+		appendProfilerMenu(menu, module, &module->profiler);
+	}
 };
 
 Model *modelClip = createModel<Clip, ClipWidget>("Clip");
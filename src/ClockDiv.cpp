@@ -1,4 +1,5 @@
 #include "aridacity.hpp"
+#include "kernel/ClockDivKernel.hpp"
 
 struct ClockDiv : Module {
 	enum ParamIds {
@@ -16,13 +17,8 @@ struct ClockDiv : Module {
 		NUM_OUTPUTS
 	};
 
-	dsp::SchmittTrigger clockTrigger;
-	dsp::SchmittTrigger resetTrigger;
-
-	const uint_t numTicks = 16;
-	uint_t index = 1;
-	bool reset = false;
-	bool divideByOne = false;
+	ClockDivKernel kernel;
+	Profiler profiler;
 
 	ClockDiv();
 	void process(const ProcessArgs &args) override;
@@ -38,78 +34,165 @@ ClockDiv::ClockDiv() {
 	configInput(ClockDiv::CLOCK_INPUT, "Clock");
 	configInput(ClockDiv::RESET_INPUT, "Reset");
 	configInput(ClockDiv::SEQ_INPUT, "Modulation");
+	profiler.fastPathName = "Unchanged frames";
 }
 
 
 void ClockDiv::process(const ProcessArgs &args) {
-	float clockVal = inputs[CLOCK_INPUT].getVoltage();
-	//increment index on clock high
-	if(clockTrigger.process(clockVal)) {
-		++index;
-		if(reset || index > numTicks) {
-			index = 1;
-			reset = false;
-		}
-	}
-	//trigger reset on next clock high
-	if(resetTrigger.process(inputs[RESET_INPUT].getVoltage()))
-		reset = true;
-
-	//clear all outputs when clock is low; nothing left to update
-	if(!clockTrigger.isHigh()) {
-		for(uint_t d = DIV_OUTPUT; d < NUM_OUTPUTS; ++d)
-			outputs[d].setVoltage(0.f);
-		return;
+	Profiler::Scope scope(profiler);
+
+	ClockDivKernel::Inputs in;
+	in.clock = getSignal(inputs[CLOCK_INPUT]);
+	in.reset = getSignal(inputs[RESET_INPUT]);
+	in.seq = getSignal(inputs[SEQ_INPUT]);
+
+	//every division carries one gate per clock channel
+	const int channels = std::max(inputs[CLOCK_INPUT].getChannels(), 1);
+	float *outs[ClockDivKernel::NUM_OUTPUTS];
+	for(int d = 0; d < ClockDivKernel::NUM_OUTPUTS; ++d) {
+		outputs[DIV_OUTPUT + d].setChannels(channels);
+		outs[d] = outputs[DIV_OUTPUT + d].getVoltages();
 	}
 
-	//if input override output value
-	if(inputs[SEQ_INPUT].isConnected())
-		clockVal = inputs[SEQ_INPUT].getVoltage();
-
-	//sequence output mode
-	if((params[SEQ_PARAM].getValue()) >= 1.f) {
-		for(uint_t d = DIV_OUTPUT; d < NUM_OUTPUTS; ++d)
-			outputs[d].setVoltage( (d == (index-1))? clockVal : 0.f );
-	}
-	//division output mode
-	else {
-		if(divideByOne && index == 1) {
-			//on divide by 1 set all outputs to input
-			for(uint_t d = DIV_OUTPUT; d < NUM_OUTPUTS; ++d)
-				outputs[d].setVoltage(clockVal);
-		}
-		else {
-			for(uint_t d = DIV_OUTPUT; d < NUM_OUTPUTS; ++d)
-				outputs[d].setVoltage( ((index % (d+1)) == 0)? clockVal : 0.f);
-		}
-	}
+	if(!kernel.process(params[SEQ_PARAM].getValue() >= 1.f, in, outs, channels))
+		profiler.countFastPath();
 }
 
 //user manually initialized module
 void ClockDiv::onReset(const ResetEvent &e) {
-	index = 1;
-	//avoid reseting parameters
+	kernel.onReset();
 }
 
 json_t* ClockDiv::dataToJson() {
 	json_t *rootJ = json_object();
 
-	json_object_set_new(rootJ, "divideByOne", json_boolean(divideByOne));
+	json_object_set_new(rootJ, "divideByOne", json_boolean(kernel.divideByOne));
+	json_object_set_new(rootJ, "cycle", json_boolean(kernel.cycle));
+	json_object_set_new(rootJ, "precise", json_boolean(kernel.precise));
+
+	json_t *ratiosJ = json_array();
+	json_t *multiplyJ = json_array();
+	for(int d = 0; d < ClockDivKernel::NUM_OUTPUTS; ++d) {
+		json_array_append_new(ratiosJ, json_integer(kernel.ratio[d]));
+		json_array_append_new(multiplyJ, json_boolean((kernel.multiplied >> d) & 1));
+	}
+	json_object_set_new(rootJ, "ratios", ratiosJ);
+	json_object_set_new(rootJ, "multiply", multiplyJ);
 	return rootJ;
 }
 void ClockDiv::dataFromJson(json_t *rootJ) {
 	json_t *divOneJ = json_object_get(rootJ, "divideByOne");
 	if(divOneJ)
-		divideByOne = json_boolean_value(divOneJ);
+		kernel.divideByOne = json_boolean_value(divOneJ);
+
+	json_t *cycleJ = json_object_get(rootJ, "cycle");
+	if(cycleJ)
+		kernel.cycle = json_boolean_value(cycleJ);
+
+	json_t *preciseJ = json_object_get(rootJ, "precise");
+	if(preciseJ)
+		kernel.precise = json_boolean_value(preciseJ);
+
+	json_t *ratiosJ = json_object_get(rootJ, "ratios");
+	json_t *multiplyJ = json_object_get(rootJ, "multiply");
+	if(ratiosJ) {
+		for(int d = 0; d < ClockDivKernel::NUM_OUTPUTS; ++d) {
+			json_t *ratioJ = json_array_get(ratiosJ, d);
+			json_t *multJ = multiplyJ? json_array_get(multiplyJ, d) : NULL;
+			if(ratioJ)
+				kernel.setRatio(d, json_integer_value(ratioJ), multJ && json_boolean_value(multJ));
+		}
+	}
+}
+
+//ratios are written as "/n" to divide or "xn" to multiply the clock
+static std::string ratioText(ClockDivKernel &kernel, int output) {
+	const bool multiply = (kernel.multiplied >> output) & 1;
+	return string::f("%s%llu", multiply? "x" : "/", (unsigned long long) kernel.ratio[output]);
+}
+static bool parseRatio(std::string text, uint64_t *ratio, bool *multiply) {
+	*multiply = false;
+	size_t pos = 0;
+	if(!text.empty() && (text[0] == 'x' || text[0] == 'X' || text[0] == '*')) {
+		*multiply = true;
+		pos = 1;
+	}
+	else if(!text.empty() && text[0] == '/')
+		pos = 1;
+
+	//digits only, within the supported range
+	if(pos >= text.size() || text.size() - pos > 10)
+		return false;
+	uint64_t value = 0;
+	for(; pos < text.size(); ++pos) {
+		if(text[pos] < '0' || text[pos] > '9')
+			return false;
+		value = value * 10 + (text[pos] - '0');
+	}
+	if(value < 1 || value > ClockDivKernel::MAX_RATIO)
+		return false;
+	*ratio = value;
+	return true;
 }
 
 struct DivideOneItem : MenuItem {
 	ClockDiv *module;
 	void onAction(const event::Action &e) override {
-		module->divideByOne ^= true;
+		module->kernel.divideByOne ^= true;
+	}
+	void step() override {
+		rightText = CHECKMARK(module->kernel.divideByOne);
+	}
+};
+
+struct CycleItem : MenuItem {
+	ClockDiv *module;
+	void onAction(const event::Action &e) override {
+		module->kernel.cycle ^= true;
+	}
+	void step() override {
+		rightText = CHECKMARK(module->kernel.cycle);
+	}
+};
+
+struct PreciseItem : MenuItem {
+	ClockDiv *module;
+	void onAction(const event::Action &e) override {
+		module->kernel.precise ^= true;
+	}
+	void step() override {
+		rightText = CHECKMARK(module->kernel.precise);
+	}
+};
+
+struct RatioField : TextField {
+	ClockDiv *module;
+	int output;
+	void onChange(const event::Change &e) override {
+		uint64_t ratio;
+		bool multiply;
+		//ignore partial entries while typing
+		if(parseRatio(text, &ratio, &multiply))
+			module->kernel.setRatio(output, ratio, multiply);
+	}
+};
+
+struct RatioItem : MenuItem {
+	ClockDiv *module;
+	int output;
+	Menu *createChildMenu() override {
+		Menu *menu = new Menu;
+		menu->addChild(construct<MenuLabel>(&MenuLabel::text, "/n divides, xn multiplies"));
+
+		RatioField *field = construct<RatioField>(&RatioField::module, module, &RatioField::output, output);
+		field->box.size.x = 120;
+		field->text = ratioText(module->kernel, output);
+		menu->addChild(field);
+		return menu;
 	}
 	void step() override {
-		rightText = CHECKMARK(module->divideByOne);
+		rightText = ratioText(module->kernel, output) + " " + RIGHT_ARROW;
+		MenuItem::step();
 	}
 };
 
@@ -154,6 +237,14 @@ struct ClockDivWidget : ModuleWidget {
 		assert(module);
 
 		menu->addChild(construct<DivideOneItem>(&MenuItem::text, "Divisible by 1", &DivideOneItem::module, module));
+		menu->addChild(construct<CycleItem>(&MenuItem::text, "Restart ratios up to /16 every 16 steps", &CycleItem::module, module));
+		menu->addChild(construct<PreciseItem>(&MenuItem::text, "Sub-sample clock timing", &PreciseItem::module, module));
+
+		menu->addChild(construct<MenuLabel>(&MenuLabel::text, "Output ratios"));
+		for(int d = 0; d < ClockDivKernel::NUM_OUTPUTS; ++d)
+			menu->addChild(construct<RatioItem>(&MenuItem::text, string::f("Output %d", d + 1), &RatioItem::module, module, &RatioItem::output, d));
+
+		appendProfilerMenu(menu, module, &module->profiler);
 	}
 };
 
@@ -0,0 +1,120 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+//lightweight timing of Module::process; one call in SAMPLE_INTERVAL is timed into a
+//decaying histogram and modules count how often their fast path skips the work
+struct Profiler {
+	//power of two so the sampling check is a mask
+	static const uint32_t SAMPLE_INTERVAL = 64;
+	//bin b holds calls taking [2^b, 2^(b+1)) ns
+	static const int NUM_BINS = 16;
+	//timed calls between halving the histogram so it follows the recent load
+	static const uint32_t DECAY_INTERVAL = 4096;
+
+	//shown in the context menu when the module has a fast path
+	const char *fastPathName = nullptr;
+
+	//written by the audio thread only and read by the menu, so plain loads and stores suffice
+	std::atomic<uint64_t> calls{0};
+	std::atomic<uint64_t> fastPaths{0};
+	std::atomic<double> bins[NUM_BINS];
+	std::atomic<double> totalNs{0.0};
+	//set by the menu and cleared by the audio thread once it has reset the counters
+	std::atomic<bool> resetRequested{false};
+	//audio thread only
+	uint32_t timed = 0;
+
+	Profiler() {
+		for(std::atomic<double> &count : bins)
+			count.store(0.0, std::memory_order_relaxed);
+	}
+
+	//times the enclosing process() call when it is due for sampling
+	struct Scope {
+		Profiler &profiler;
+		bool timing;
+		std::chrono::steady_clock::time_point start;
+
+		Scope(Profiler &profiler) : profiler(profiler) {
+			if(profiler.resetRequested.load(std::memory_order_relaxed))
+				profiler.reset();
+			const uint64_t calls = profiler.calls.load(std::memory_order_relaxed) + 1;
+			profiler.calls.store(calls, std::memory_order_relaxed);
+			timing = (calls & (SAMPLE_INTERVAL - 1)) == 0;
+			if(timing)
+				start = std::chrono::steady_clock::now();
+		}
+		~Scope() {
+			if(timing) {
+				const auto end = std::chrono::steady_clock::now();
+				profiler.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+			}
+		}
+	};
+
+	//single writer increment without a locked read-modify-write
+	template <typename T>
+	static void add(std::atomic<T> &x, T value) {
+		x.store(x.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	void countFastPath() {
+		add<uint64_t>(fastPaths, 1);
+	}
+
+	void record(int64_t ns) {
+		//floor of log2, clamped to the last bin
+		const int bin = 63 - __builtin_clzll(uint64_t(ns) | 1);
+		add(bins[bin < NUM_BINS? bin : NUM_BINS - 1], 1.0);
+		add(totalNs, double(ns));
+
+		if(++timed % DECAY_INTERVAL == 0) {
+			for(std::atomic<double> &count : bins)
+				count.store(count.load(std::memory_order_relaxed) * 0.5, std::memory_order_relaxed);
+			totalNs.store(totalNs.load(std::memory_order_relaxed) * 0.5, std::memory_order_relaxed);
+		}
+	}
+
+	//weight of recent timed calls in the histogram
+	double getWeight() const {
+		double weight = 0.0;
+		for(const std::atomic<double> &count : bins)
+			weight += count.load(std::memory_order_relaxed);
+		return weight;
+	}
+
+	double getMeanNs() const {
+		const double weight = getWeight();
+		return (weight > 0.0)? totalNs.load(std::memory_order_relaxed) / weight : 0.0;
+	}
+
+	//upper edge of the bin containing the given fraction of recent timed calls
+	double getPercentileNs(double fraction) const {
+		const double weight = getWeight();
+		double below = 0.0;
+		for(int b = 0; b < NUM_BINS; ++b) {
+			below += bins[b].load(std::memory_order_relaxed);
+			if(below > 0.0 && below >= fraction * weight)
+				return double(uint64_t(2) << b);
+		}
+		return 0.0;
+	}
+
+	//GUI thread; the audio thread clears the counters at the start of its next process() call
+	void requestReset() {
+		resetRequested.store(true, std::memory_order_relaxed);
+	}
+
+	//audio thread
+	void reset() {
+		calls.store(0, std::memory_order_relaxed);
+		fastPaths.store(0, std::memory_order_relaxed);
+		for(std::atomic<double> &count : bins)
+			count.store(0.0, std::memory_order_relaxed);
+		totalNs.store(0.0, std::memory_order_relaxed);
+		timed = 0;
+		resetRequested.store(false, std::memory_order_relaxed);
+	}
+};
@@ -1,6 +1,7 @@
 #include "aridacity.hpp"
+#include "kernel/RemainderKernel.hpp"
 
-struct Remainder : Module {
+struct Remainder : ChainModule {
 	enum ParamId {
 		GAIN_PARAM,
 		FEEDBACK_PARAM,
@@ -27,7 +28,9 @@ struct Remainder : Module {
 		NUM_OUTPUTS
 	};
 
-	float lastWet = 0.f;
+	RemainderKernel kernel;
+	ControlSmoother<NUM_PARAMS> smoother;
+	Profiler profiler;
 
 	Remainder() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS);
@@ -54,40 +57,156 @@ struct Remainder : Module {
 		configInput(FOLD_INPUT, "Fold");
 		configOutput(AUDIO_OUTPUT, "Audio");
 		configBypass(AUDIO_INPUT, AUDIO_OUTPUT);
+
+		kernel.sampleRate = APP->engine->getSampleRate();
+		chainInput = AUDIO_INPUT;
+		chainOutput = AUDIO_OUTPUT;
+	}
+
+	void onSampleRateChange(const SampleRateChangeEvent& e) override {
+		kernel.sampleRate = e.sampleRate;
 	}
 
-	void process(const ProcessArgs& args) override {
-		float dry = inputs[AUDIO_INPUT].getVoltageSum();
-		float gain = params[GAIN_PARAM].getValue() + params[GAIN_CV_PARAM].getValue() * inputs[GAIN_INPUT].getVoltage();
-		float divisor = params[FOLD_PARAM].getValue() + inputs[FOLD_INPUT].getVoltage();
+	int getLatency() override {
+		return kernel.getLatency();
+	}
+
+	void processAudio(const ProcessArgs& args, Signal audio) override {
+		Profiler::Scope scope(profiler);
+
+		const int channels = std::max(audio.channels, 1);
+		outputs[AUDIO_OUTPUT].setChannels(channels);
 
-		//attenuate audio
-		float in = (dry * gain);
-		float feedback = params[FEEDBACK_PARAM].getValue() + params[FEEDBACK_CV_PARAM].getValue() * inputs[FEEDBACK_INPUT].getVoltage() / 10.f;
-		in += lastWet * feedback;
-		//initialize output
-		float wet = 0.f;
+		//all knobs are continuous so every one is smoothed
+		if(smoother.isReadFrame()) {
+			for(int i = 0; i < NUM_PARAMS; ++i)
+				smoother.set(i, params[i].getValue());
+		}
+		smoother.process();
+
+		RemainderKernel::Controls controls;
+		controls.gain = smoother.get(GAIN_PARAM);
+		controls.gainCv = smoother.get(GAIN_CV_PARAM);
+		controls.fold = smoother.get(FOLD_PARAM);
+		controls.feedback = smoother.get(FEEDBACK_PARAM);
+		controls.feedbackCv = smoother.get(FEEDBACK_CV_PARAM);
+		controls.shape = smoother.get(SHAPE_PARAM);
+		controls.shapeCv = smoother.get(SHAPE_CV_PARAM);
+		controls.mix = smoother.get(MIX_PARAM);
+		controls.mixCv = smoother.get(MIX_CV_PARAM);
+
+		RemainderKernel::Inputs in;
+		in.audio = audio;
+		in.gain = getSignal(inputs[GAIN_INPUT]);
+		in.feedback = getSignal(inputs[FEEDBACK_INPUT]);
+		in.shape = getSignal(inputs[SHAPE_INPUT]);
+		in.mix = getSignal(inputs[MIX_INPUT]);
+		in.fold = getSignal(inputs[FOLD_INPUT]);
 
-		//avoid divide by zero
-		if(fabs(divisor) > 0.01f) {
-			float shape = params[SHAPE_PARAM].getValue() + params[SHAPE_CV_PARAM].getValue() * inputs[SHAPE_INPUT].getVoltage() / 10.f;
-			shape = clamp(shape, 0.f, 1.f);
+		kernel.process(controls, in, outputs[AUDIO_OUTPUT].getVoltages(), channels);
+	}
+
+	json_t* dataToJson() override {
+		json_t *rootJ = json_object();
 
-			//fold audio using remainder
-			float remainder = std::trunc(in / divisor) * divisor;
-			divisor *= 2.f;
-			float remSigned = std::round(in / divisor) * divisor;
+		json_object_set_new(rootJ, "antiAlias", json_boolean(kernel.antiAlias));
+		json_object_set_new(rootJ, "oversample", json_integer(kernel.oversample));
+		json_object_set_new(rootJ, "smoothing", json_boolean(smoother.enabled));
+		json_object_set_new(rootJ, "stabilize", json_boolean(kernel.stabilize));
+		json_object_set_new(rootJ, "fastFold", json_boolean(kernel.fastFold));
+		json_object_set_new(rootJ, "chain", json_boolean(chain));
+		return rootJ;
+	}
+	void dataFromJson(json_t *rootJ) override {
+		json_t *antiAliasJ = json_object_get(rootJ, "antiAlias");
+		if(antiAliasJ)
+			kernel.antiAlias = json_boolean_value(antiAliasJ);
 
-			wet = in - crossfade(remainder, remSigned, shape);
+		//ignore factors without a filter so the latency always matches the processing
+		json_t *oversampleJ = json_object_get(rootJ, "oversample");
+		if(oversampleJ) {
+			const int factor = json_integer_value(oversampleJ);
+			kernel.oversample = getOversampleFilter(factor)? factor : 1;
 		}
-		lastWet = wet;
 
-		float mix = params[MIX_PARAM].getValue() + params[MIX_CV_PARAM].getValue() * inputs[MIX_INPUT].getVoltage() / 10.f;
-		mix = clamp(mix, 0.f, 1.f);
-		outputs[AUDIO_OUTPUT].setVoltage(crossfade(dry, wet, mix));
+		json_t *smoothingJ = json_object_get(rootJ, "smoothing");
+		if(smoothingJ)
+			smoother.enabled = json_boolean_value(smoothingJ);
+
+		json_t *stabilizeJ = json_object_get(rootJ, "stabilize");
+		if(stabilizeJ)
+			kernel.stabilize = json_boolean_value(stabilizeJ);
+
+		json_t *fastFoldJ = json_object_get(rootJ, "fastFold");
+		if(fastFoldJ)
+			kernel.fastFold = json_boolean_value(fastFoldJ);
+
+		json_t *chainJ = json_object_get(rootJ, "chain");
+		if(chainJ)
+			chain = json_boolean_value(chainJ);
+	}
+};
+
+
+struct RemainderAntiAliasItem : MenuItem {
+	Remainder *module;
+	void onAction(const event::Action &e) override {
+		module->kernel.antiAlias ^= true;
+	}
+	void step() override {
+		rightText = CHECKMARK(module->kernel.antiAlias);
 	}
 };
 
+struct RemainderSmoothingItem : MenuItem {
+	Remainder *module;
+	void onAction(const event::Action &e) override {
+		module->smoother.enabled ^= true;
+	}
+	void step() override {
+		rightText = CHECKMARK(module->smoother.enabled);
+	}
+};
+
+struct StabilizeItem : MenuItem {
+	Remainder *module;
+	void onAction(const event::Action &e) override {
+		module->kernel.stabilize ^= true;
+	}
+	void step() override {
+		rightText = CHECKMARK(module->kernel.stabilize);
+	}
+};
+
+struct OversampleItem : MenuItem {
+	Remainder *module;
+	int factor;
+	void onAction(const event::Action &e) override {
+		module->kernel.oversample = factor;
+	}
+	void step() override {
+		rightText = CHECKMARK(module->kernel.oversample == factor);
+	}
+};
+
+struct FoldDivisionItem : MenuItem {
+	Remainder *module;
+	bool fast;
+	void onAction(const event::Action &e) override {
+		module->kernel.fastFold = fast;
+	}
+	void step() override {
+		rightText = CHECKMARK(module->kernel.fastFold == fast);
+	}
+};
+
+struct LatencyLabel : MenuLabel {
+	Remainder *module;
+	void step() override {
+		text = string::f("Latency: %d samples", module->kernel.getLatency());
+		MenuLabel::step();
+	}
+};
 
 struct RemainderWidget : ModuleWidget {
 	RemainderWidget(Remainder* module) {
@@ -119,6 +238,34 @@ struct RemainderWidget : ModuleWidget {
 		addInput(createInputCentered<SmallWhitePort>(Vec(60, 340), module, Remainder::FOLD_INPUT));
 		addOutput(createOutputCentered<SmallBlackPort>(Vec(90, 340), module, Remainder::AUDIO_OUTPUT));
 	}
+
+	void appendContextMenu(Menu *menu) override {
+		menu->addChild(new MenuEntry);
+
+		Remainder *module = dynamic_cast<Remainder*>(this->module);
+		assert(module);
+
+		menu->addChild(construct<RemainderAntiAliasItem>(&MenuItem::text, "Anti-aliasing (ADAA)", &RemainderAntiAliasItem::module, module));
+		menu->addChild(construct<RemainderSmoothingItem>(&MenuItem::text, "Smooth knob changes", &RemainderSmoothingItem::module, module));
+		menu->addChild(construct<StabilizeItem>(&MenuItem::text, "Stabilize feedback", &StabilizeItem::module, module));
+
+		menu->addChild(construct<MenuLabel>(&MenuLabel::text, "Fold division"));
+		menu->addChild(construct<FoldDivisionItem>(&MenuItem::text, "Exact", &FoldDivisionItem::module, module, &FoldDivisionItem::fast, false));
+		menu->addChild(construct<FoldDivisionItem>(&MenuItem::text, "Fast (reciprocal)", &FoldDivisionItem::module, module, &FoldDivisionItem::fast, true));
+
+		menu->addChild(construct<MenuLabel>(&MenuLabel::text, "Oversampling"));
+		menu->addChild(construct<OversampleItem>(&MenuItem::text, "Off", &OversampleItem::module, module, &OversampleItem::factor, 1));
+		menu->addChild(construct<OversampleItem>(&MenuItem::text, "2x", &OversampleItem::module, module, &OversampleItem::factor, 2));
+		menu->addChild(construct<OversampleItem>(&MenuItem::text, "4x", &OversampleItem::module, module, &OversampleItem::factor, 4));
+		menu->addChild(construct<OversampleItem>(&MenuItem::text, "8x", &OversampleItem::module, module, &OversampleItem::factor, 8));
+		menu->addChild(construct<LatencyLabel>(&LatencyLabel::module, module));
+
+		appendChainMenu(menu, module);
+
+		appendTelemetryMenu(menu, &module->telemetry);
+
+		appendProfilerMenu(menu, module, &module->profiler);
+	}
 };
 
 
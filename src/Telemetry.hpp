@@ -0,0 +1,65 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+//streams decimated input and output voltages of a module's first channel from the audio
+//thread to its displays; a single producer and consumer share a lock free ring buffer and
+//the audio thread only checks an atomic counter while no display is open
+struct Telemetry {
+	//power of two so positions wrap with a mask
+	static const uint32_t CAPACITY = 1024;
+	//audio frames per point
+	static const uint32_t DECIMATION = 8;
+	//longest module latency the input is delayed by to line up with the output
+	static const uint32_t MAX_LATENCY = 2048;
+
+	struct Point {
+		float in;
+		float out;
+	};
+
+	Point points[CAPACITY];
+	std::atomic<uint32_t> writePos{0};
+	std::atomic<uint32_t> readPos{0};
+	//open displays; the audio thread pushes only while there is one
+	std::atomic<int> displays{0};
+
+	//audio thread state
+	uint32_t frame = 0;
+	float inputs[MAX_LATENCY] = {};
+
+	bool isActive() const {
+		return displays.load(std::memory_order_relaxed) > 0;
+	}
+
+	//audio thread; never blocks and drops points while the display is behind
+	void push(float in, float out, int latency) {
+		inputs[frame & (MAX_LATENCY - 1)] = in;
+		const uint32_t delayed = frame - std::min(uint32_t(latency), MAX_LATENCY - 1);
+		if(++frame % DECIMATION != 0)
+			return;
+
+		const uint32_t w = writePos.load(std::memory_order_relaxed);
+		if(w - readPos.load(std::memory_order_acquire) >= CAPACITY)
+			return;
+		points[w & (CAPACITY - 1)] = {inputs[delayed & (MAX_LATENCY - 1)], out};
+		writePos.store(w + 1, std::memory_order_release);
+	}
+
+	//GUI thread; copies up to max of the oldest unread points
+	int pop(Point *out, int max) {
+		const uint32_t r = readPos.load(std::memory_order_relaxed);
+		const uint32_t w = writePos.load(std::memory_order_acquire);
+		const int n = std::min(int(w - r), max);
+		for(int i = 0; i < n; ++i)
+			out[i] = points[(r + i) & (CAPACITY - 1)];
+		readPos.store(r + n, std::memory_order_release);
+		return n;
+	}
+
+	//GUI thread; skip points left from an earlier display
+	void flush() {
+		readPos.store(writePos.load(std::memory_order_acquire), std::memory_order_release);
+	}
+};
@@ -1,12 +1,211 @@
 #include "aridacity.hpp"
 
 Plugin *pluginInstance;
+ComponentSvgs componentSvgs;
+
+const char *const ComponentSvgs::files[NUM_SVGS] = {
+	"smallWhiteSwitch0.svg",
+	"smallWhiteSwitch1.svg",
+	"whiteSwitch0.svg",
+	"whiteSwitch1.svg",
+	"whiteSwitch2.svg",
+	"LEDSwitchToggle.svg",
+	"smallWhiteKnob.svg",
+	"whiteKnob.svg",
+	"smallWhitePort.svg",
+	"smallBlackPort.svg"
+};
+
+void ComponentSvgs::init(Plugin *plugin) {
+	for(int i = 0; i < NUM_SVGS; ++i)
+		paths[i] = asset::plugin(plugin, std::string("res/ComponentLibrary/") + files[i]);
+}
 
 void init(Plugin *p) {
 	pluginInstance = p;
+	componentSvgs.init(p);
 
 	p->addModel(modelClockDiv);
 	p->addModel(modelBCrush);
 	p->addModel(modelClip);
 	p->addModel(modelRemainder);
 }
+
+
+struct ChainItem : MenuItem {
+	ChainModule *module;
+	void onAction(const event::Action &e) override {
+		module->chain = !module->chain;
+	}
+	void step() override {
+		rightText = CHECKMARK(module->chain);
+	}
+};
+
+void appendChainMenu(Menu *menu, ChainModule *module) {
+	menu->addChild(new MenuEntry);
+	menu->addChild(construct<ChainItem>(&MenuItem::text, "Chain audio from the module to the left", &ChainItem::module, module));
+}
+
+
+static json_t *profilerToJson(Module *module, Profiler *profiler) {
+	json_t *rootJ = json_object();
+	json_object_set_new(rootJ, "id", json_integer(module->id));
+	json_object_set_new(rootJ, "calls", json_integer(profiler->calls.load(std::memory_order_relaxed)));
+	json_object_set_new(rootJ, "sampleInterval", json_integer(Profiler::SAMPLE_INTERVAL));
+	json_object_set_new(rootJ, "meanNs", json_real(profiler->getMeanNs()));
+	json_object_set_new(rootJ, "p50Ns", json_real(profiler->getPercentileNs(0.5)));
+	json_object_set_new(rootJ, "p99Ns", json_real(profiler->getPercentileNs(0.99)));
+
+	//bins are named by their lower edge in ns
+	json_t *histogramJ = json_array();
+	for(int b = 0; b < Profiler::NUM_BINS; ++b) {
+		json_t *binJ = json_object();
+		json_object_set_new(binJ, "minNs", json_integer(int64_t(1) << b));
+		json_object_set_new(binJ, "weight", json_real(profiler->bins[b].load(std::memory_order_relaxed)));
+		json_array_append_new(histogramJ, binJ);
+	}
+	json_object_set_new(rootJ, "histogram", histogramJ);
+
+	if(profiler->fastPathName) {
+		json_object_set_new(rootJ, "fastPath", json_string(profiler->fastPathName));
+		json_object_set_new(rootJ, "fastPathCalls", json_integer(profiler->fastPaths.load(std::memory_order_relaxed)));
+	}
+	return rootJ;
+}
+
+struct ProfilerTimeLabel : MenuLabel {
+	Profiler *profiler;
+	void step() override {
+		text = string::f("Mean %.0f ns, p50 < %.0f ns, p99 < %.0f ns", profiler->getMeanNs(),
+			profiler->getPercentileNs(0.5), profiler->getPercentileNs(0.99));
+		MenuLabel::step();
+	}
+};
+
+struct ProfilerFastPathLabel : MenuLabel {
+	Profiler *profiler;
+	void step() override {
+		const uint64_t calls = profiler->calls.load(std::memory_order_relaxed);
+		const uint64_t fastPaths = profiler->fastPaths.load(std::memory_order_relaxed);
+		const double percent = calls? 100.0 * fastPaths / calls : 0.0;
+		text = string::f("%s: %.1f%% of calls", profiler->fastPathName, percent);
+		MenuLabel::step();
+	}
+};
+
+struct ProfilerCopyItem : MenuItem {
+	Module *module;
+	Profiler *profiler;
+	void onAction(const event::Action &e) override {
+		json_t *rootJ = profilerToJson(module, profiler);
+		char *text = json_dumps(rootJ, JSON_INDENT(2));
+		glfwSetClipboardString(APP->window->win, text);
+		free(text);
+		json_decref(rootJ);
+	}
+};
+
+struct ProfilerResetItem : MenuItem {
+	Profiler *profiler;
+	void onAction(const event::Action &e) override {
+		profiler->requestReset();
+	}
+};
+
+void appendProfilerMenu(Menu *menu, Module *module, Profiler *profiler) {
+	menu->addChild(new MenuEntry);
+	menu->addChild(construct<MenuLabel>(&MenuLabel::text, "CPU profile"));
+	menu->addChild(construct<ProfilerTimeLabel>(&ProfilerTimeLabel::profiler, profiler));
+	if(profiler->fastPathName)
+		menu->addChild(construct<ProfilerFastPathLabel>(&ProfilerFastPathLabel::profiler, profiler));
+	menu->addChild(construct<ProfilerCopyItem>(&MenuItem::text, "Copy profile as JSON", &ProfilerCopyItem::module, module, &ProfilerCopyItem::profiler, profiler));
+	menu->addChild(construct<ProfilerResetItem>(&MenuItem::text, "Reset profile", &ProfilerResetItem::profiler, profiler));
+}
+
+
+//transfer curve on the left and waveform on the right of the last HISTORY points
+struct TelemetryDisplay : Widget {
+	static const int HISTORY = 512;
+	//voltage at the edges of both plots
+	const float range = 10.f;
+
+	Telemetry *telemetry;
+	Telemetry::Point history[HISTORY] = {};
+	int head = 0;
+
+	TelemetryDisplay(Telemetry *telemetry) : telemetry(telemetry) {
+		box.size = Vec(240.f, 100.f);
+		telemetry->flush();
+		++telemetry->displays;
+	}
+	~TelemetryDisplay() {
+		--telemetry->displays;
+	}
+
+	void step() override {
+		Telemetry::Point points[Telemetry::CAPACITY];
+		const int n = telemetry->pop(points, Telemetry::CAPACITY);
+		for(int i = 0; i < n; ++i) {
+			history[head] = points[i];
+			head = (head + 1) % HISTORY;
+		}
+		Widget::step();
+	}
+
+	float toY(float v) const {
+		return box.size.y * 0.5f * (1.f - clamp(v / range, -1.f, 1.f));
+	}
+
+	void draw(const DrawArgs &args) override {
+		NVGcontext *vg = args.vg;
+		const float size = box.size.y;
+
+		nvgBeginPath(vg);
+		nvgRect(vg, 0.f, 0.f, box.size.x, box.size.y);
+		nvgFillColor(vg, nvgRGB(0x10, 0x10, 0x10));
+		nvgFill(vg);
+
+		//center lines of both plots
+		nvgBeginPath(vg);
+		nvgMoveTo(vg, size * 0.5f, 0.f);
+		nvgLineTo(vg, size * 0.5f, size);
+		nvgMoveTo(vg, 0.f, size * 0.5f);
+		nvgLineTo(vg, box.size.x, size * 0.5f);
+		nvgStrokeColor(vg, nvgRGB(0x40, 0x40, 0x40));
+		nvgStrokeWidth(vg, 1.f);
+		nvgStroke(vg);
+
+		//output against input
+		nvgBeginPath(vg);
+		for(const Telemetry::Point &p : history) {
+			const float x = size * 0.5f * (1.f + clamp(p.in / range, -1.f, 1.f));
+			nvgRect(vg, x - 0.5f, toY(p.out) - 0.5f, 1.f, 1.f);
+		}
+		nvgFillColor(vg, nvgRGB(0xff, 0xff, 0xff));
+		nvgFill(vg);
+
+		//input and output over time, oldest on the left
+		const float left = size + 4.f;
+		const float dx = (box.size.x - left) / (HISTORY - 1);
+		for(int trace = 0; trace < 2; ++trace) {
+			nvgBeginPath(vg);
+			for(int i = 0; i < HISTORY; ++i) {
+				const Telemetry::Point &p = history[(head + i) % HISTORY];
+				const float y = toY(trace? p.out : p.in);
+				if(i == 0)
+					nvgMoveTo(vg, left, y);
+				else
+					nvgLineTo(vg, left + i * dx, y);
+			}
+			nvgStrokeColor(vg, trace? nvgRGB(0xff, 0xff, 0xff) : nvgRGB(0x60, 0x60, 0x60));
+			nvgStroke(vg);
+		}
+	}
+};
+
+void appendTelemetryMenu(Menu *menu, Telemetry *telemetry) {
+	menu->addChild(new MenuEntry);
+	menu->addChild(construct<MenuLabel>(&MenuLabel::text, "Channel 1 transfer and waveform"));
+	menu->addChild(new TelemetryDisplay(telemetry));
+}
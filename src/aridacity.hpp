@@ -1,7 +1,12 @@
 #include <rack.hpp>
+#include <atomic>
+#include "kernel/Signal.hpp"
+#include "Profiler.hpp"
+#include "Telemetry.hpp"
 
 typedef unsigned int uint_t;
 using namespace rack;
+using simd::float_4;
 
 extern Plugin *pluginInstance;
 
@@ -10,22 +15,213 @@ extern Model *modelBCrush;
 extern Model *modelClip;
 extern Model *modelRemainder;
 
+//port voltages as a plain buffer for the DSP kernels
+inline Signal getSignal(Port &port) {
+	return Signal(port.getVoltages(), port.getChannels());
+}
+
+//audio modules placed side by side run as one chain; the leftmost processes every module to
+//its right that has chaining on and an unpatched audio input on the same frame, so there is no
+//cable delay between them
+struct ChainModule : Module {
+	//ports carrying the audio through the chain
+	int chainInput = 0;
+	int chainOutput = 0;
+	//take the audio from the module to the left; off by default so an unpatched input in a
+	//patch saved before chaining existed stays silent. Toggled from the menu while the engine runs
+	std::atomic<bool> chain{false};
+	//engine frame this module last ran on; its own process() and the chain to its left may see
+	//different chain states in one frame on different threads, so whichever claims the frame runs it.
+	//A toggle can skip the module for that frame but never runs it twice
+	std::atomic<int64_t> claimedFrame{-1};
+	Telemetry telemetry;
+
+	//process one frame of audio from the audio input or the module to the left
+	virtual void processAudio(const ProcessArgs &args, Signal audio) = 0;
+
+	//samples the audio output lags the input
+	virtual int getLatency() {
+		return 0;
+	}
+
+	//adjacent chain modules, read every frame since the engine updates the expanders when modules move
+	static ChainModule *getChainModule(Module *module) {
+		if(!module)
+			return nullptr;
+		const bool chainModel = module->model == modelBCrush || module->model == modelClip || module->model == modelRemainder;
+		return chainModel? static_cast<ChainModule*>(module) : nullptr;
+	}
+
+	//the module to the left runs this one
+	bool isChained() {
+		return chain.load(std::memory_order_relaxed) && getChainModule(leftExpander.module)
+			&& !inputs[chainInput].isConnected();
+	}
+
+	//true for the first caller on each frame, which runs this module
+	bool claim(int64_t frame) {
+		int64_t last = claimedFrame.load(std::memory_order_relaxed);
+		return last != frame && claimedFrame.compare_exchange_strong(last, frame);
+	}
+
+	void process(const ProcessArgs &args) override {
+		if(isChained() || !claim(args.frame))
+			return;
+		processChain(args, getSignal(inputs[chainInput]));
+	}
+
+	void processBypass(const ProcessArgs &args) override {
+		if(isChained() || !claim(args.frame))
+			return;
+		Module::processBypass(args);
+		processNext(args);
+	}
+
+	void processChain(const ProcessArgs &args, Signal audio) {
+		if(isBypassed()) {
+			Output &out = outputs[chainOutput];
+			out.setChannels(audio.channels);
+			for(int c = 0; c < audio.channels; ++c)
+				out.setVoltage(audio.voltages[c], c);
+		}
+		else {
+			processAudio(args, audio);
+		}
+		if(telemetry.isActive())
+			telemetry.push((audio.channels > 0)? audio.voltages[0] : 0.f, outputs[chainOutput].getVoltage(0), getLatency());
+		processNext(args);
+	}
+
+	void processNext(const ProcessArgs &args) {
+		ChainModule *right = getChainModule(rightExpander.module);
+		if(right && right->isChained() && right->claim(args.frame))
+			right->processChain(args, getSignal(outputs[chainOutput]));
+	}
+};
+
+//chaining toggle of a chain module for its context menu
+void appendChainMenu(Menu *menu, ChainModule *module);
+
+//CPU readout and JSON export of a module's profiler for its context menu
+void appendProfilerMenu(Menu *menu, Module *module, Profiler *profiler);
+
+//live transfer curve and waveform of a module's first channel for its context menu
+void appendTelemetryMenu(Menu *menu, Telemetry *telemetry);
+
+//frames between knob reads when smoothing is enabled
+static const int SMOOTH_BLOCK = 16;
+
+//linear ramp towards a control value, advanced once per frame
+struct SmoothedValue {
+	float value = 0.f;
+	float target = 0.f;
+	float delta = 0.f;
+	int remaining = 0;
+
+	//jump straight to a value
+	void reset(float value) {
+		this->value = target = value;
+		remaining = 0;
+	}
+	//ramp from the current value to target over the next frames
+	void setTarget(float target, int frames) {
+		this->target = target;
+		delta = (target - value) / frames;
+		remaining = frames;
+	}
+	float process() {
+		if(remaining > 0) {
+			//land exactly on the target to avoid drift between blocks
+			value = (--remaining == 0)? target : value + delta;
+		}
+		return value;
+	}
+};
+
+//knob values read every SMOOTH_BLOCK frames and ramped in between to remove zipper noise;
+//when disabled every frame reads the exact knob values, which is the default so patches
+//saved before smoothing existed sound the same
+template <int N>
+struct ControlSmoother {
+	bool enabled = false;
+	SmoothedValue values[N];
+	int frame = 0;
+	//false until the first read so a new ramp does not start from zero
+	bool primed = false;
+
+	//true on frames that should read the knobs
+	bool isReadFrame() const {
+		return !enabled || frame == 0;
+	}
+	void set(int id, float value) {
+		if(enabled && primed)
+			values[id].setTarget(value, SMOOTH_BLOCK);
+		else
+			values[id].reset(value);
+	}
+	//advance all ramps by one frame
+	void process() {
+		primed = enabled;
+		if(!enabled)
+			return;
+		for(SmoothedValue &value : values)
+			value.process();
+		frame = (frame + 1) % SMOOTH_BLOCK;
+	}
+	float get(int id) const {
+		return values[id].value;
+	}
+};
+
+//component library SVGs shared by every widget instance; paths are resolved once in init()
+//and each SVG is loaded on first use since no window exists yet during init()
+struct ComponentSvgs {
+	enum Id {
+		SMALL_WHITE_SWITCH_0,
+		SMALL_WHITE_SWITCH_1,
+		WHITE_SWITCH_0,
+		WHITE_SWITCH_1,
+		WHITE_SWITCH_2,
+		LED_SWITCH_TOGGLE,
+		SMALL_WHITE_KNOB,
+		WHITE_KNOB,
+		SMALL_WHITE_PORT,
+		SMALL_BLACK_PORT,
+		NUM_SVGS
+	};
+
+	//file names in res/ComponentLibrary
+	static const char *const files[NUM_SVGS];
+	std::string paths[NUM_SVGS];
+	std::shared_ptr<Svg> svgs[NUM_SVGS];
+
+	void init(Plugin *plugin);
+	//widgets are only created on the UI thread so no locking is needed
+	std::shared_ptr<Svg> get(Id id) {
+		if(!svgs[id])
+			svgs[id] = Svg::load(paths[id]);
+		return svgs[id];
+	}
+};
+
+extern ComponentSvgs componentSvgs;
+
 struct SmallWhiteSwitch : app::SvgSwitch {
 	SmallWhiteSwitch() {
-		addFrame(Svg::load(asset::plugin(pluginInstance, "res/ComponentLibrary/smallWhiteSwitch0.svg")));
-		addFrame(Svg::load(asset::plugin(pluginInstance, "res/ComponentLibrary/smallWhiteSwitch1.svg")));
+		addFrame(componentSvgs.get(ComponentSvgs::SMALL_WHITE_SWITCH_0));
+		addFrame(componentSvgs.get(ComponentSvgs::SMALL_WHITE_SWITCH_1));
 	}
 };
 struct WhiteSwitch : app::SvgSwitch {
 	WhiteSwitch() {
-		addFrame(Svg::load(asset::plugin(pluginInstance, "res/ComponentLibrary/whiteSwitch0.svg")));
-		addFrame(Svg::load(asset::plugin(pluginInstance, "res/ComponentLibrary/whiteSwitch1.svg")));
-		addFrame(Svg::load(asset::plugin(pluginInstance, "res/ComponentLibrary/whiteSwitch2.svg")));
+		addFrame(componentSvgs.get(ComponentSvgs::WHITE_SWITCH_0));
+		addFrame(componentSvgs.get(ComponentSvgs::WHITE_SWITCH_1));
+		addFrame(componentSvgs.get(ComponentSvgs::WHITE_SWITCH_2));
 	}
 };
 struct LEDSwitchToggle : app::SvgSwitch {
 	LEDSwitchToggle() {
-		addFrame(Svg::load(asset::plugin(pluginInstance, "res/ComponentLibrary/LEDSwitchToggle.svg")));
+		addFrame(componentSvgs.get(ComponentSvgs::LED_SWITCH_TOGGLE));
 	}
 };
 template <typename BASE>
@@ -38,22 +234,22 @@ struct LEDSwitchLight : BASE {
 
 struct SmallWhiteKnob : RoundKnob {
 	SmallWhiteKnob() {
-		setSvg(Svg::load(asset::plugin(pluginInstance, "res/ComponentLibrary/smallWhiteKnob.svg")));
+		setSvg(componentSvgs.get(ComponentSvgs::SMALL_WHITE_KNOB));
 	}
 };
 struct WhiteKnob : RoundKnob {
 	WhiteKnob() {
-		setSvg(Svg::load(asset::plugin(pluginInstance, "res/ComponentLibrary/whiteKnob.svg")));
+		setSvg(componentSvgs.get(ComponentSvgs::WHITE_KNOB));
 	}
 };
 
 struct SmallWhitePort : SVGPort {
 	SmallWhitePort() {
-		setSvg(Svg::load(asset::plugin(pluginInstance, "res/ComponentLibrary/smallWhitePort.svg")));
+		setSvg(componentSvgs.get(ComponentSvgs::SMALL_WHITE_PORT));
 	}
 };
 struct SmallBlackPort : SVGPort {
 	SmallBlackPort() {
-		setSvg(Svg::load(asset::plugin(pluginInstance, "res/ComponentLibrary/smallBlackPort.svg")));
+		setSvg(componentSvgs.get(ComponentSvgs::SMALL_BLACK_PORT));
 	}
 };
@@ -0,0 +1,246 @@
+#pragma once
+#include "Signal.hpp"
+#include "Blep.hpp"
+#include <dsp/digital.hpp>
+
+struct BCrushKernel {
+	struct Controls {
+		float sampleRate;
+		float resolution;
+	};
+	struct Inputs {
+		Signal audio;
+		Signal sampleRate;
+		Signal clockHold;
+		Signal resolution;
+		Signal gain;
+		Signal shiftL;
+		Signal shiftR;
+		Signal bitAnd;
+		Signal bitOr;
+		Signal bitXor;
+		Signal bitNot;
+	};
+
+	enum BitOp {
+		SHIFT_LEFT,
+		SHIFT_RIGHT,
+		AND,
+		OR,
+		XOR,
+		NOT
+	};
+	struct Op {
+		BitOp type;
+		Signal Inputs::*input;
+	};
+
+	//controls and connections are sampled once per block
+	static const int BLOCK_SIZE = 32;
+	int blockFrame = 0;
+
+	Controls controls = {};
+	bool holdConnected = false;
+	bool gainConnected = false;
+	//patched bit operations in the order they apply
+	Op ops[6];
+	int numOps = 0;
+
+	//per channel sample and hold clocks
+	dsp::TSchmittTrigger<float_4> holdTrigger[4];
+	float_4 curSampleTime[4] = {};
+	//channels taking a new sample this frame
+	float_4 update[4] = {};
+
+	//spread each new sample's step over the band limited step table instead of holding it at once
+	bool bandLimit = false;
+	bool blepActive = false;
+	BlepHold blep[4];
+	//samples since each channel's hold clock fired, for placing its step between frames
+	float_4 stepTime[4] = {};
+	float_4 lastHold[4] = {};
+	//audio interpolated at the step time so each sample matches where its step is placed
+	float_4 lastAudio[4] = {};
+	float_4 sampledAudio[4] = {};
+
+	const float maxRes = 12.8f;
+
+	//true on the first frame of each block
+	bool isBlockStart() {
+		const bool start = (blockFrame == 0);
+		if(++blockFrame >= BLOCK_SIZE)
+			blockFrame = 0;
+		return start;
+	}
+
+	void prepare(const Controls &controls, const Inputs &inputs) {
+		this->controls = controls;
+		holdConnected = inputs.clockHold.isConnected();
+		gainConnected = inputs.gain.isConnected();
+
+		numOps = 0;
+		addOp(inputs, SHIFT_LEFT, &Inputs::shiftL);
+		addOp(inputs, SHIFT_RIGHT, &Inputs::shiftR);
+		addOp(inputs, AND, &Inputs::bitAnd);
+		addOp(inputs, OR, &Inputs::bitOr);
+		addOp(inputs, XOR, &Inputs::bitXor);
+		addOp(inputs, NOT, &Inputs::bitNot);
+	}
+	void addOp(const Inputs &inputs, BitOp type, Signal Inputs::*input) {
+		if((inputs.*input).isConnected()) {
+			ops[numOps].type = type;
+			ops[numOps].input = input;
+			++numOps;
+		}
+	}
+
+	//advance each channel's hold clock; true when any channel takes a new sample
+	bool tick(const Inputs &inputs, float sampleRate, int channels) {
+		if(!bandLimit)
+			blepActive = false;
+
+		int updated = 0;
+		for(int c = 0; c < channels; c += 4) {
+			if(holdConnected) {
+				//update output on clock input
+				const float_4 hold = inputs.clockHold.getPolyVoltageSimd(c);
+				update[c / 4] = holdTrigger[c / 4].process(hold);
+				if(bandLimit) {
+					//interpolate the high threshold crossing; the previous frame was below it
+					stepTime[c / 4] = (hold - 1.f) / (hold - lastHold[c / 4]);
+					lastHold[c / 4] = hold;
+				}
+			}
+			else {
+				//add time according to sample rate; same min/max order as scalar clamp()
+				const float_4 time = (controls.sampleRate + (inputs.sampleRate.getPolyVoltageSimd(c) / 10.f)) * sampleRate;
+				const float_4 increment = simd::fmax(simd::fmin(time, sampleRate), 100.f);
+				curSampleTime[c / 4] += increment;
+
+				//update output if enough time has passed
+				update[c / 4] = curSampleTime[c / 4] >= sampleRate;
+				curSampleTime[c / 4] -= simd::ifelse(update[c / 4], sampleRate, 0.f);
+				//the time left over is how far past the frame boundary the sample was due
+				if(bandLimit)
+					stepTime[c / 4] = curSampleTime[c / 4] / increment;
+			}
+			if(bandLimit) {
+				const float_4 audio = inputs.audio.getVoltageSimd(c);
+				stepTime[c / 4] = simd::fmax(simd::fmin(stepTime[c / 4], 1.f), 0.f);
+				sampledAudio[c / 4] = audio - stepTime[c / 4] * (audio - lastAudio[c / 4]);
+				lastAudio[c / 4] = audio;
+			}
+			updated |= simd::movemask(update[c / 4]) << c;
+		}
+		//ignore lanes past the last channel
+		return (updated & ((1 << channels) - 1)) != 0;
+	}
+
+	void crush(const Inputs &inputs, float *out, int channels) {
+		if(bandLimit)
+			startBandLimit(out, channels);
+
+		//process 4 channels at a time; monophonic CV applies to all channels
+		for(int c = 0; c < channels; c += 4) {
+			//keep held channels
+			if(simd::movemask(update[c / 4]) == 0)
+				continue;
+
+			//limit resolution to avoid divide by zero; same NaN handling as std::max
+			float_4 ampRes = (controls.resolution + inputs.resolution.getPolyVoltageSimd(c)) * maxRes;
+			ampRes = simd::ifelse(ampRes < 1.f, 1.f, ampRes);
+
+			float_4 audi = (bandLimit? sampledAudio[c / 4] : inputs.audio.getVoltageSimd(c)) / 5.f;
+
+			if(gainConnected)
+				audi *= (inputs.gain.getPolyVoltageSimd(c) / 5.f);
+
+			//quantize output according to resolution input
+			__m128i quant = toInt(audi * ampRes);
+
+			//apply patched bit operations and quantize their inputs
+			for(int i = 0; i < numOps; ++i) {
+				const float_4 v = (inputs.*ops[i].input).getPolyVoltageSimd(c);
+				switch(ops[i].type) {
+					case SHIFT_LEFT:
+						quant = shiftLeft(quant, toInt(simd::fabs(v / 100.f) * ampRes));
+						break;
+					case SHIFT_RIGHT:
+						quant = shiftRight(quant, toInt((v / 100.f) * ampRes));
+						break;
+					case AND:
+						quant = _mm_and_si128(quant, toInt((v / 10.f) * ampRes));
+						break;
+					case OR:
+						quant = _mm_or_si128(quant, toInt((v / 10.f) * ampRes));
+						break;
+					case XOR:
+						quant = _mm_xor_si128(quant, toInt((v / 10.f) * ampRes));
+						break;
+					case NOT:
+						quant = _mm_xor_si128(quant, _mm_castps_si128((simd::fabs(v) > 1.f).v));
+						break;
+				}
+			}
+
+			//descale output for channels taking a new sample
+			float_4 y = (float_4(_mm_cvtepi32_ps(quant)) / ampRes) * 5.f;
+			if(bandLimit) {
+				blep[c / 4].step(simd::ifelse(update[c / 4], y, blep[c / 4].held), stepTime[c / 4]);
+				continue;
+			}
+			y = simd::ifelse(update[c / 4], y, float_4::load(&out[c]));
+			y.store(&out[c]);
+		}
+	}
+
+	//write the band limited output; called on every frame in band limited mode after crush()
+	void render(float *out, int channels) {
+		startBandLimit(out, channels);
+		for(int c = 0; c < channels; c += 4)
+			blep[c / 4].process().store(&out[c]);
+	}
+
+	//continue from the current output when band limiting is switched on
+	void startBandLimit(const float *out, int channels) {
+		if(blepActive)
+			return;
+		for(int c = 0; c < 16; c += 4)
+			blep[c / 4].reset((c < channels)? float_4::load(&out[c]) : 0.f);
+		blepActive = true;
+	}
+
+	//samples the output lags the input
+	int getLatency() const {
+		return bandLimit? BLEP_ZERO_CROSSINGS : 0;
+	}
+
+	//truncate like static_cast<int>
+	static __m128i toInt(float_4 x) {
+		return _mm_cvttps_epi32(x.v);
+	}
+
+	//per lane shifts by the low 5 bits of n, as scalar shifts do on x86 and ARM
+	static __m128i shiftLeft(__m128i x, __m128i n) {
+		x = select(n, 1, x, _mm_slli_epi32(x, 1));
+		x = select(n, 2, x, _mm_slli_epi32(x, 2));
+		x = select(n, 4, x, _mm_slli_epi32(x, 4));
+		x = select(n, 8, x, _mm_slli_epi32(x, 8));
+		x = select(n, 16, x, _mm_slli_epi32(x, 16));
+		return x;
+	}
+	//arithmetic shift keeps the sign of negative values
+	static __m128i shiftRight(__m128i x, __m128i n) {
+		x = select(n, 1, x, _mm_srai_epi32(x, 1));
+		x = select(n, 2, x, _mm_srai_epi32(x, 2));
+		x = select(n, 4, x, _mm_srai_epi32(x, 4));
+		x = select(n, 8, x, _mm_srai_epi32(x, 8));
+		x = select(n, 16, x, _mm_srai_epi32(x, 16));
+		return x;
+	}
+	//take shifted in lanes where n has the bit set
+	static __m128i select(__m128i n, int bit, __m128i x, __m128i shifted) {
+		const __m128i mask = _mm_cmpeq_epi32(_mm_and_si128(n, _mm_set1_epi32(bit)), _mm_set1_epi32(bit));
+		return _mm_or_si128(_mm_and_si128(mask, shifted), _mm_andnot_si128(mask, x));
+	}
+};
@@ -0,0 +1,111 @@
+#pragma once
+#include "Signal.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+//samples of the band limited step on each side of the edge; band limited output lags by this many samples
+static const int BLEP_ZERO_CROSSINGS = 8;
+static const int BLEP_LENGTH = 2 * BLEP_ZERO_CROSSINGS;
+//fractional edge positions in the table; positions between them are interpolated
+static const int BLEP_PHASES = 64;
+
+//band limited step minus the ideal step, sampled around edges at every table position
+struct BlepTable {
+	//residual[p][k] is the correction k - BLEP_ZERO_CROSSINGS samples after an edge p / BLEP_PHASES samples late
+	float residual[BLEP_PHASES + 1][BLEP_LENGTH];
+
+	BlepTable() {
+		//integrate a Blackman windowed sinc at the host Nyquist frequency on a fine grid
+		const int steps = 16;
+		const int points = BLEP_LENGTH * BLEP_PHASES * steps;
+		const double dt = 1.0 / (BLEP_PHASES * steps);
+		std::vector<double> step(points + 1);
+		double sum = 0.0;
+		step[0] = 0.0;
+		for(int i = 0; i < points; ++i) {
+			//midpoint of each grid interval
+			const double t = (i + 0.5) * dt - BLEP_ZERO_CROSSINGS;
+			const double w = 2.0 * M_PI * (t + BLEP_ZERO_CROSSINGS) / BLEP_LENGTH;
+			const double sinc = (t == 0.0)? 1.0 : std::sin(M_PI * t) / (M_PI * t);
+			sum += sinc * (0.42 - 0.5 * std::cos(w) + 0.08 * std::cos(2.0 * w)) * dt;
+			step[i + 1] = sum;
+		}
+
+		for(int p = 0; p <= BLEP_PHASES; ++p) {
+			for(int k = 0; k < BLEP_LENGTH; ++k) {
+				//grid index of k - BLEP_ZERO_CROSSINGS + p / BLEP_PHASES samples after the window start
+				const int i = (k * BLEP_PHASES + p) * steps;
+				const double ideal = (k >= BLEP_ZERO_CROSSINGS)? 1.0 : 0.0;
+				residual[p][k] = step[std::min(i, points)] / sum - ideal;
+			}
+		}
+	}
+};
+
+//computed once when the plugin loads
+static const BlepTable blepTable;
+
+//held value of 4 channels with band limited steps; the output lags by BLEP_ZERO_CROSSINGS frames
+struct BlepHold {
+	float_4 held = 0.f;
+	//held values of the last BLEP_LENGTH frames
+	float_4 history[BLEP_LENGTH] = {};
+	//pending step corrections of each channel from the current frame on; the first half is
+	//consumed and the second half moves down every BLEP_LENGTH frames so steps never wrap
+	float correction[4][2 * BLEP_LENGTH] = {};
+	int pos = 0;
+
+	//start holding value without steps in flight
+	void reset(float_4 value) {
+		held = value;
+		for(int k = 0; k < BLEP_LENGTH; ++k)
+			history[k] = value;
+		for(int i = 0; i < 4; ++i) {
+			for(int k = 0; k < 2 * BLEP_LENGTH; ++k)
+				correction[i][k] = 0.f;
+		}
+		pos = 0;
+	}
+
+	//hold value from this frame on; each lane's edge fell frac samples before the frame
+	void step(float_4 value, float_4 frac) {
+		const float_4 height = value - held;
+		held = value;
+		int lanes = simd::movemask(height != 0.f);
+		while(lanes) {
+			const int i = __builtin_ctz(lanes);
+			lanes &= lanes - 1;
+
+			const float p = clamp(frac[i], 0.f, 1.f) * BLEP_PHASES;
+			const int p0 = std::min(int(p), BLEP_PHASES - 1);
+			const float w = p - p0;
+			const float *r0 = blepTable.residual[p0];
+			const float *r1 = blepTable.residual[p0 + 1];
+			float *c = &correction[i][pos];
+			for(int k = 0; k < BLEP_LENGTH; k += 4) {
+				const float_4 a = float_4::load(&r0[k]);
+				const float_4 r = a + w * (float_4::load(&r1[k]) - a);
+				(float_4::load(&c[k]) + height[i] * r).store(&c[k]);
+			}
+		}
+	}
+
+	//band limited value BLEP_ZERO_CROSSINGS frames ago; call once per frame after step()
+	float_4 process() {
+		const int h = pos % BLEP_LENGTH;
+		history[h] = held;
+		const float_4 y = history[(h + BLEP_ZERO_CROSSINGS) % BLEP_LENGTH]
+			+ float_4(correction[0][pos], correction[1][pos], correction[2][pos], correction[3][pos]);
+		if(++pos >= BLEP_LENGTH) {
+			for(int i = 0; i < 4; ++i) {
+				for(int k = 0; k < BLEP_LENGTH; ++k) {
+					correction[i][k] = correction[i][k + BLEP_LENGTH];
+					correction[i][k + BLEP_LENGTH] = 0.f;
+				}
+			}
+			pos = 0;
+		}
+		return y;
+	}
+};
@@ -0,0 +1,217 @@
+#pragma once
+#include "Signal.hpp"
+#include "Crossover.hpp"
+#include "Lookahead.hpp"
+
+//push and limit boundaries for 4 channels
+struct ClipShape {
+	float_4 pushHi, pushLo;
+	float_4 limLo, limHi;
+	bool pull, enableLimit;
+
+	float_4 limit(float_4 audi) const {
+		//same min/max order as scalar clamp() when limits cross
+		return enableLimit? simd::fmax(simd::fmin(audi, limHi), limLo) : audi;
+	}
+
+	float_4 transfer(float_4 audi) const {
+		//push inside if in range
+		const float_4 inside = (audi < pushHi) & (audi > pushLo);
+		const float_4 pushed = pull ? float_4::zero() : simd::ifelse(audi > 0.f, pushHi, pushLo);
+		audi = simd::ifelse(inside, pushed, audi);
+
+		//clip limit outside
+		return limit(audi);
+	}
+
+	//first order antiderivative anti-aliasing between the previous input x1 and x
+	float_4 transferAdaa(float_4 x, float_4 x1) const {
+		const float_4 dx = x - x1;
+		//slope is ill-conditioned for nearly equal inputs; use the midpoint instead
+		const float_4 ill = simd::fabs(dx) < 1e-5f;
+		const float_4 y = 0.5f * (x + x1) + deviation(x, x1) / dx;
+		return simd::ifelse(ill, transfer(0.5f * (x + x1)), y);
+	}
+
+	//change between x1 and x of the transfer antiderivative minus x*x/2
+	float_4 deviation(float_4 x, float_4 x1) const {
+		float_4 d = limitDeviation(x, x1);
+		//positive half of the push region moves to pushHi, negative half to pushLo
+		d += regionDeviation(x, x1, simd::fmax(pushLo, 0.f), pushHi, pull? float_4::zero() : pushHi);
+		d += regionDeviation(x, x1, pushLo, simd::fmin(pushHi, 0.f), pull? float_4::zero() : pushLo);
+		return d;
+	}
+
+	//the limit is x*x/2 plus a parabola outside each limit
+	float_4 limitDeviation(float_4 x, float_4 x1) const {
+		if(!enableLimit)
+			return 0.f;
+		//crossed limits hold at the lower limit
+		const float_4 hi = simd::fmax(limHi, limLo);
+		return squareDiff(simd::fmin(x, limLo), simd::fmin(x1, limLo), limLo)
+			+ squareDiff(simd::fmax(x, hi), simd::fmax(x1, hi), hi);
+	}
+
+	//inside (lo, hi) the limited identity is replaced by the limited value
+	float_4 regionDeviation(float_4 x, float_4 x1, float_4 lo, float_4 hi, float_4 value) const {
+		hi = simd::fmax(hi, lo);
+		const float_4 s = simd::fmin(simd::fmax(x, lo), hi);
+		const float_4 s1 = simd::fmin(simd::fmax(x1, lo), hi);
+		return squareDiff(s, s1, limit(value)) - limitDeviation(s, s1);
+	}
+
+	//difference of -(g - center)^2 / 2, factored to avoid cancellation
+	static float_4 squareDiff(float_4 g, float_4 g1, float_4 center) {
+		return -0.5f * (g - g1) * (g + g1 - 2.f * center);
+	}
+};
+
+struct ClipKernel {
+	struct Controls {
+		float gain;
+		float push;
+		float limit;
+		bool pull;
+		bool enableLimit;
+	};
+	struct Inputs {
+		Signal audio;
+		Signal gain;
+		Signal pushSize;
+		Signal pushPos;
+		Signal limitSize;
+		Signal limitPos;
+	};
+
+	bool antiAlias = false;
+	//previous scaled input of each band for anti-aliasing
+	float_4 lastIn[MAX_BANDS][4] = {};
+
+	//multi-band mode; 1 clips the full band
+	int bands = 1;
+	//crossover frequencies in Hz from low to high
+	float crossover[MAX_BANDS - 1] = {DEFAULT_CROSSOVERS[0], DEFAULT_CROSSOVERS[1], DEFAULT_CROSSOVERS[2]};
+	//push and limit size of each band relative to the controls
+	float bandPush[MAX_BANDS] = {1.f, 1.f, 1.f, 1.f};
+	float bandLimit[MAX_BANDS] = {1.f, 1.f, 1.f, 1.f};
+	float sampleRate = 44100.f;
+	CrossoverBank crossoverBank[4];
+	//settings the crossover bank was last tuned for
+	int tunedBands = 1;
+	float tunedCrossover[MAX_BANDS - 1] = {};
+	float tunedRate = 0.f;
+
+	//replace the outer limit clamp with the lookahead true peak limiter
+	bool lookahead = false;
+	LookaheadLimiter limiter;
+	bool limiting = false;
+
+	//allocates the lookahead buffers for the new rate
+	void setSampleRate(float sampleRate) {
+		this->sampleRate = sampleRate;
+		limiter.setSampleRate(sampleRate);
+	}
+
+	//samples the output lags the input
+	int getLatency() const {
+		return (lookahead && limiter.isAllocated())? limiter.getLatency() : 0;
+	}
+
+	void process(const Controls &controls, const Inputs &inputs, float *out, int channels) {
+		const int bands = clamp(this->bands, 1, MAX_BANDS);
+		if(bands > 1)
+			tune(bands);
+		else
+			//the bank is idle, so the next split must start from silence
+			tunedBands = 1;
+
+		//the limiter takes over the outer limit, so the clip shapes only push
+		const bool useLimiter = lookahead && controls.enableLimit && limiter.isAllocated();
+		if(useLimiter && !limiting)
+			limiter.reset();
+		limiting = useLimiter;
+		if(limiting)
+			limiter.advance();
+		Controls clipControls = controls;
+		clipControls.enableLimit &= !limiting;
+
+		//process 4 channels at a time; monophonic CV applies to all channels
+		for(int c = 0; c < channels; c += 4) {
+			const float_4 pushSiz = controls.push + (inputs.pushSize.getPolyVoltageSimd(c) / 10.f);
+			const float_4 pushCent = inputs.pushPos.getPolyVoltageSimd(c) / 5.f;
+
+			const float_4 limit = controls.limit + (inputs.limitSize.getPolyVoltageSimd(c) / 10.f);
+			const float_4 limCenter = inputs.limitPos.getPolyVoltageSimd(c) / 5.f;
+
+			float_4 audi = inputs.audio.getVoltageSimd(c) / 5.f;
+
+			//add gain
+			audi *= controls.gain + (inputs.gain.getPolyVoltageSimd(c) / 10.f);
+
+			if(bands > 1) {
+				//clip each band with its own sizes around the shared centers
+				float_4 split[MAX_BANDS];
+				crossoverBank[c / 4].process(audi, split);
+				audi = 0.f;
+				for(int b = 0; b < bands; ++b) {
+					const ClipShape shape = getShape(clipControls, pushCent, pushSiz * bandPush[b], limCenter, limit * bandLimit[b]);
+					audi += clipSample(shape, split[b], lastIn[b][c / 4]);
+				}
+			}
+			else {
+				const ClipShape shape = getShape(clipControls, pushCent, pushSiz, limCenter, limit);
+				audi = clipSample(shape, audi, lastIn[0][c / 4]);
+			}
+			if(limiting)
+				audi = limiter.process(c, audi, limCenter, limit, std::min(channels - c, 4));
+			(audi * 5.f).store(&out[c]);
+		}
+	}
+
+	static ClipShape getShape(const Controls &controls, float_4 pushCent, float_4 pushSiz, float_4 limCenter, float_4 limit) {
+		ClipShape shape;
+		//add center offset
+		shape.pushHi = pushCent + pushSiz;
+		shape.pushLo = pushCent - pushSiz;
+		shape.limLo = limCenter - limit;
+		shape.limHi = limCenter + limit;
+		shape.pull = controls.pull;
+		shape.enableLimit = controls.enableLimit;
+		return shape;
+	}
+
+	float_4 clipSample(const ClipShape &shape, float_4 audi, float_4 &last) {
+		if(!antiAlias)
+			return shape.transfer(audi);
+
+		const float_4 y = shape.transferAdaa(audi, last);
+		last = audi;
+		return y;
+	}
+
+	//retune the crossovers when the band count, frequencies or sample rate change
+	void tune(int bands) {
+		bool changed = bands != tunedBands || sampleRate != tunedRate;
+		for(int j = 0; j < bands - 1; ++j)
+			changed |= crossover[j] != tunedCrossover[j];
+		if(!changed)
+			return;
+
+		//keep frequencies rising and below Nyquist
+		float f[MAX_BANDS - 1];
+		float lowest = 10.f / sampleRate;
+		for(int j = 0; j < bands - 1; ++j) {
+			f[j] = clamp(crossover[j] / sampleRate, lowest, 0.45f);
+			lowest = f[j];
+			tunedCrossover[j] = crossover[j];
+		}
+		for(CrossoverBank &bank : crossoverBank) {
+			//a new split starts from silence
+			if(bands != tunedBands)
+				bank.reset();
+			bank.setFrequencies(bands, f);
+		}
+		tunedBands = bands;
+		tunedRate = sampleRate;
+	}
+};
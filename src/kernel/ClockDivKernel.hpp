@@ -0,0 +1,289 @@
+#pragma once
+#include "Signal.hpp"
+#include <dsp/digital.hpp>
+#include <algorithm>
+#include <cmath>
+
+struct ClockDivKernel {
+	static const int NUM_OUTPUTS = 16;
+	//largest division or multiplication ratio of an output
+	static const uint64_t MAX_RATIO = uint64_t(1) << 32;
+
+	struct Inputs {
+		Signal clock;
+		Signal reset;
+		Signal seq;
+	};
+
+	//per output ratio; outputs in the multiplied mask emit ratio gates per clock period
+	uint64_t ratio[NUM_OUTPUTS];
+	uint32_t multiplied = 0;
+	//restart ratio counters every numTicks steps like the original 16 step divider; ratios
+	//longer than the cycle keep counting so they still fire
+	bool cycle = true;
+	//time clock edges between samples and round gate changes to the nearest sample
+	bool precise = false;
+
+	//per channel state as parallel arrays so a 16 channel clock stays in a few cache lines
+	dsp::TSchmittTrigger<float_4> clockTrigger[4];
+	dsp::TSchmittTrigger<float_4> resetTrigger[4];
+	uint32_t index[16];
+	//clock edges left until each divided output fires, indexed by channel then output
+	uint64_t count[16][NUM_OUTPUTS];
+	//divided outputs firing on the current step
+	uint32_t stepMask[16];
+	//outputs written high on the last change, and their voltage
+	uint32_t lastMask[16] = {};
+	float lastValue[16] = {};
+
+	//clock period measurement in samples and the multiplied gates following it
+	int64_t frame = 0;
+	double lastEdge[16] = {};
+	double period[16] = {};
+	//clock voltage of the previous frame to find where an edge crossed the threshold
+	float lastClock[16] = {};
+	//frame of the next multiplied gate change
+	double nextEvent[16];
+	uint32_t gateMask[16] = {};
+
+	const uint32_t numTicks = 16;
+	//one bit per channel waiting for a reset on the next clock high
+	uint32_t reset = 0;
+	//one bit per channel on the step its ratio counters restarted
+	uint32_t restarted = 0;
+	//one bit per channel that has seen a clock edge to measure from
+	uint32_t clocked = 0;
+	bool divideByOne = false;
+	int channels = 0;
+
+	//clock state and modes seen on the last frame
+	uint32_t lastHigh = 0;
+	bool lastSequence = false;
+	bool lastDivideByOne = false;
+	uint32_t lastMultiplied = 0;
+
+	ClockDivKernel() {
+		for(int d = 0; d < NUM_OUTPUTS; ++d)
+			ratio[d] = d + 1;
+		onReset();
+	}
+
+	void setRatio(int output, uint64_t ratio, bool multiply) {
+		this->ratio[output] = std::max(std::min(ratio, uint64_t(MAX_RATIO)), uint64_t(1));
+		if(multiply)
+			multiplied |= 1u << output;
+		else
+			multiplied &= ~(1u << output);
+	}
+
+	//outs holds one polyphonic voltage buffer per division; false when no channel changed
+	bool process(bool sequence, const Inputs &inputs, float *const *outs, int channels) {
+		//outputs dropped by a smaller channel count are cleared by the port
+		for(int c = channels; c < this->channels; ++c) {
+			lastMask[c] = 0;
+			lastValue[c] = 0.f;
+			lastHigh &= ~(1u << c);
+		}
+		this->channels = channels;
+
+		const uint32_t lanes = (1u << channels) - 1;
+
+		//a mode change rewrites every channel
+		uint32_t visit = 0;
+		const bool modeChanged = sequence != lastSequence || divideByOne != lastDivideByOne || multiplied != lastMultiplied;
+		if(modeChanged)
+			visit = lanes;
+		lastSequence = sequence;
+		lastDivideByOne = divideByOne;
+		lastMultiplied = multiplied;
+
+		uint32_t rising = 0;
+		uint32_t high = 0;
+		float values[16];
+		float clock[16];
+		//if input override output value
+		const Signal &valueInput = inputs.seq.isConnected()? inputs.seq : inputs.clock;
+		for(int c = 0; c < channels; c += 4) {
+			float_4 clockVal = inputs.clock.getPolyVoltageSimd(c);
+			clockVal.store(&clock[c]);
+			rising |= simd::movemask(clockTrigger[c / 4].process(clockVal)) << c;
+			high |= simd::movemask(clockTrigger[c / 4].isHigh()) << c;
+
+			float_4 value = valueInput.getPolyVoltageSimd(c);
+			value.store(&values[c]);
+			visit |= simd::movemask(value != float_4::load(&lastValue[c])) << c;
+		}
+		//only clock edges move the index
+		visit |= high ^ lastHigh;
+		lastHigh = high;
+
+		//multiplied gates change between clock edges when their next event is due
+		++frame;
+		const double now = getTime();
+		if(multiplied) {
+			for(int c = 0; c < channels; ++c) {
+				if(now >= nextEvent[c])
+					visit |= 1u << c;
+			}
+		}
+		visit &= lanes;
+
+		//reset requests arriving now wait for the next clock high
+		uint32_t resetTriggered = 0;
+		for(int c = 0; c < channels; c += 4)
+			resetTriggered |= simd::movemask(resetTrigger[c / 4].process(inputs.reset.getPolyVoltageSimd(c))) << c;
+
+		const bool changed = visit != 0;
+		while(visit) {
+			const int c = __builtin_ctz(visit);
+			visit &= visit - 1;
+
+			if((rising >> c) & 1) {
+				//measure the clock period from the previous edge
+				const double edge = getEdgeTime(clock[c], lastClock[c]);
+				if((clocked >> c) & 1)
+					period[c] = edge - lastEdge[c];
+				clocked |= 1u << c;
+				lastEdge[c] = edge;
+
+				step(c);
+			}
+			if(multiplied && (modeChanged || ((rising >> c) & 1) || now >= nextEvent[c]))
+				updateGates(c);
+
+			//select the outputs that are high for this step
+			uint32_t mask = 0;
+			if((high >> c) & 1) {
+				//sequence output mode
+				if(sequence)
+					mask = 1 << (index[c]-1);
+				//division output mode; on divide by 1 set all outputs to input
+				else if(divideByOne && ((restarted >> c) & 1))
+					mask = 0xffff;
+				else
+					mask = stepMask[c];
+			}
+			//multiplied outputs keep their own gates while the clock is low
+			uint32_t gates = 0;
+			if(!sequence) {
+				mask &= ~multiplied;
+				gates = gateMask[c] & multiplied;
+				mask |= gates;
+			}
+			const float gateValue = inputs.seq.isConnected()? values[c] : 10.f;
+
+			//rewrite outputs that were or are becoming high
+			uint32_t changed = mask | lastMask[c];
+			while(changed) {
+				const int d = __builtin_ctz(changed);
+				outs[d][c] = ((mask >> d) & 1)? (((gates >> d) & 1)? gateValue : values[c]) : 0.f;
+				changed &= changed - 1;
+			}
+			lastMask[c] = mask;
+			lastValue[c] = values[c];
+		}
+		//trigger reset on next clock high
+		reset |= resetTriggered;
+
+		for(int c = 0; c < channels; ++c)
+			lastClock[c] = clock[c];
+		return changed;
+	}
+
+	//time compared against gate events; half a sample ahead rounds them to the nearest frame
+	double getTime() const {
+		return precise? frame + 0.5 : frame;
+	}
+
+	//frame position of a rising edge seen on this frame
+	double getEdgeTime(float in, float lastIn) const {
+		if(!precise)
+			return frame;
+		//interpolate the high threshold crossing; the previous frame was below it
+		const float threshold = 1.f;
+		const float frac = (in - threshold) / (in - lastIn);
+		return frame - clamp(frac, 0.f, 1.f);
+	}
+
+	//advance a channel by one clock edge
+	void step(int c) {
+		//increment index on clock high
+		++index[c];
+		const bool resetting = (reset >> c) & 1;
+		const bool wrapped = index[c] > numTicks;
+		if(resetting || wrapped) {
+			index[c] = 1;
+			reset &= ~(1u << c);
+		}
+		if(resetting || (cycle && wrapped))
+			restart(c, !resetting);
+		else
+			restarted &= ~(1u << c);
+
+		stepMask[c] = countDown(c);
+	}
+
+	//count divided outputs from the start of their ratio again; a cycle wrap leaves the
+	//ratios longer than numTicks running, since restarting them would never let them fire
+	void restart(int c, bool wrap) {
+		for(int d = 0; d < NUM_OUTPUTS; ++d) {
+			if(!wrap || ratio[d] <= numTicks)
+				count[c][d] = ratio[d];
+		}
+		restarted |= 1u << c;
+	}
+
+	//one edge closer to every divided output's next pulse; returns the outputs firing
+	uint32_t countDown(int c) {
+		uint32_t fired = 0;
+		for(int d = 0; d < NUM_OUTPUTS; ++d) {
+			//ratio may have been lowered since the last step
+			uint64_t &n = count[c][d];
+			n = std::min(n, ratio[d]);
+			if(--n == 0) {
+				fired |= 1u << d;
+				n = ratio[d];
+			}
+		}
+		return fired & ~multiplied;
+	}
+
+	//set multiplied gates for the time since the last clock edge and schedule their next change
+	void updateGates(int c) {
+		uint32_t gates = 0;
+		double next = INFINITY;
+		const double sinceEdge = getTime() - lastEdge[c];
+		//wait for two edges to know the period
+		if(period[c] > 0.0) {
+			uint32_t outputs = multiplied;
+			while(outputs) {
+				const int d = __builtin_ctz(outputs);
+				outputs &= outputs - 1;
+
+				//count half periods of the multiplied clock; high on the first half of each
+				const double halfPeriod = period[c] / (2.0 * ratio[d]);
+				const uint64_t halves = uint64_t(sinceEdge / halfPeriod);
+				//stop after ratio pulses if the clock slows down or stops
+				if(halves >= 2 * ratio[d])
+					continue;
+				if((halves & 1) == 0)
+					gates |= 1u << d;
+				next = std::min(next, (halves + 1) * halfPeriod);
+			}
+		}
+		gateMask[c] = gates;
+		nextEvent[c] = lastEdge[c] + next;
+	}
+
+	//user manually initialized module
+	void onReset() {
+		for(int c = 0; c < 16; ++c) {
+			index[c] = 1;
+			//start as if the first step had just been counted
+			restart(c, false);
+			stepMask[c] = countDown(c);
+			nextEvent[c] = INFINITY;
+		}
+		//avoid reseting parameters
+	}
+};
@@ -0,0 +1,119 @@
+#pragma once
+#include "Signal.hpp"
+#include <cmath>
+
+static const int MAX_BANDS = 4;
+//crossover frequencies in Hz of a new Clip, from low to high
+static const float DEFAULT_CROSSOVERS[MAX_BANDS - 1] = {200.f, 2000.f, 8000.f};
+
+//transposed direct form II biquad filtering 4 channels at once
+struct Biquad {
+	enum Type {
+		LOWPASS,
+		HIGHPASS,
+		ALLPASS
+	};
+
+	float b0 = 1.f, b1 = 0.f, b2 = 0.f;
+	float a1 = 0.f, a2 = 0.f;
+	float_4 s1 = 0.f, s2 = 0.f;
+
+	//cookbook coefficients; f is the cutoff relative to the sample rate
+	void setParameters(Type type, float f, float q) {
+		const float w = 2.f * M_PI * f;
+		const float cosw = std::cos(w);
+		const float alpha = std::sin(w) / (2.f * q);
+		const float a0 = 1.f + alpha;
+		switch(type) {
+			case LOWPASS:
+				b0 = b2 = (1.f - cosw) / 2.f / a0;
+				b1 = (1.f - cosw) / a0;
+				break;
+			case HIGHPASS:
+				b0 = b2 = (1.f + cosw) / 2.f / a0;
+				b1 = -(1.f + cosw) / a0;
+				break;
+			case ALLPASS:
+				b0 = (1.f - alpha) / a0;
+				b1 = -2.f * cosw / a0;
+				b2 = 1.f;
+				break;
+		}
+		a1 = -2.f * cosw / a0;
+		a2 = (1.f - alpha) / a0;
+	}
+
+	void reset() {
+		s1 = s2 = 0.f;
+	}
+
+	float_4 process(float_4 x) {
+		const float_4 y = b0 * x + s1;
+		s1 = b1 * x - a1 * y + s2;
+		s2 = b2 * x - a2 * y;
+		return y;
+	}
+};
+
+//Linkwitz-Riley 4th order split; low plus high is a 2nd order allpass
+struct LR4Split {
+	Biquad low[2];
+	Biquad high[2];
+
+	void setFrequency(float f) {
+		for(int i = 0; i < 2; ++i) {
+			low[i].setParameters(Biquad::LOWPASS, f, M_SQRT1_2);
+			high[i].setParameters(Biquad::HIGHPASS, f, M_SQRT1_2);
+		}
+	}
+
+	void reset() {
+		for(int i = 0; i < 2; ++i) {
+			low[i].reset();
+			high[i].reset();
+		}
+	}
+
+	void process(float_4 x, float_4 *lo, float_4 *hi) {
+		*lo = low[1].process(low[0].process(x));
+		*hi = high[1].process(high[0].process(x));
+	}
+};
+
+//splits 4 channels into bands from low to high whose sum has a flat magnitude response
+struct CrossoverBank {
+	int bands = 1;
+	LR4Split splits[MAX_BANDS - 1];
+	//allpass[b][j] gives band b the phase of the later crossover j so the bands recombine coherently
+	Biquad allpass[MAX_BANDS][MAX_BANDS - 1];
+
+	//f holds bands - 1 rising crossover frequencies relative to the sample rate
+	void setFrequencies(int bands, const float *f) {
+		this->bands = bands;
+		for(int j = 0; j < bands - 1; ++j) {
+			splits[j].setFrequency(f[j]);
+			for(int b = 0; b < j; ++b)
+				allpass[b][j].setParameters(Biquad::ALLPASS, f[j], M_SQRT1_2);
+		}
+	}
+
+	void reset() {
+		for(int j = 0; j < MAX_BANDS - 1; ++j) {
+			splits[j].reset();
+			for(int b = 0; b < MAX_BANDS; ++b)
+				allpass[b][j].reset();
+		}
+	}
+
+	void process(float_4 x, float_4 *out) {
+		float_4 rest = x;
+		for(int j = 0; j < bands - 1; ++j) {
+			float_4 hi;
+			splits[j].process(rest, &out[j], &hi);
+			for(int b = 0; b < j; ++b)
+				out[b] = allpass[b][j].process(out[b]);
+			rest = hi;
+		}
+		out[bands - 1] = rest;
+	}
+};
@@ -0,0 +1,200 @@
+#pragma once
+#include "Oversampler.hpp"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+//lookahead range in ms; buffers are sized for the longest when the sample rate changes
+static const float MIN_LOOKAHEAD_MS = 0.5f;
+static const float MAX_LOOKAHEAD_MS = 10.f;
+static const float DEFAULT_LOOKAHEAD_MS = 2.f;
+//the 4x peak detector interpolates from a centered window and lags its input by this many samples
+static const int DETECTOR_LATENCY = OVERSAMPLE_TAPS / 2;
+
+//delay line and gain history of one channel
+struct LookaheadChannel {
+	//signal waiting for its gain, relative to the limit center
+	std::vector<float> delay;
+	//limit center and size each delayed sample was measured against
+	std::vector<float> delayCenter;
+	std::vector<float> delaySize;
+	//held gains averaged into the applied gain
+	std::vector<float> holds;
+	double holdSum = 0.0;
+	//sliding minimum of the required gains as a monotonic deque of frame and gain
+	std::vector<int64_t> dequeFrame;
+	std::vector<float> dequeGain;
+	int dequeHead = 0;
+	int dequeSize = 0;
+};
+
+//true peak limiter; the gain needed for every 4x oversampled peak is held for the lookahead
+//window and averaged over it, so the gain has settled by the time the delayed peak arrives
+struct LookaheadLimiter {
+	//lookahead in ms
+	float lookahead = DEFAULT_LOOKAHEAD_MS;
+
+	float sampleRate = 0.f;
+	int maxLength = 0;
+	//lookahead in samples the state was last reset for
+	int length = 0;
+	int64_t frame = 0;
+	//ring positions of the current frame, shared by every channel
+	int holdPos = 0;
+	int holdOldest = 0;
+	int delayPos = 0;
+	int delayRead = 0;
+	Oversampler detector[4];
+	LookaheadChannel channels[16];
+
+	LookaheadLimiter() {
+		for(Oversampler &o : detector)
+			o.setFilter(getOversampleFilter(4));
+	}
+
+	//allocates every buffer; never called from process()
+	void setSampleRate(float sampleRate) {
+		this->sampleRate = sampleRate;
+		maxLength = getLength(MAX_LOOKAHEAD_MS);
+		for(LookaheadChannel &ch : channels) {
+			ch.delay.assign(maxLength + DETECTOR_LATENCY + 1, 0.f);
+			ch.delayCenter.assign(maxLength + DETECTOR_LATENCY + 1, 0.f);
+			ch.delaySize.assign(maxLength + DETECTOR_LATENCY + 1, 0.f);
+			ch.holds.assign(maxLength + 2, 1.f);
+			ch.dequeFrame.assign(maxLength + 2, 0);
+			ch.dequeGain.assign(maxLength + 2, 1.f);
+		}
+		length = 0;
+		reset();
+	}
+
+	bool isAllocated() const {
+		return maxLength > 0;
+	}
+
+	int getLength(float ms) const {
+		return std::max(int(std::round(ms * sampleRate / 1000.f)), 1);
+	}
+
+	int getLatency() const {
+		return getLength(clamp(lookahead, MIN_LOOKAHEAD_MS, MAX_LOOKAHEAD_MS)) + DETECTOR_LATENCY;
+	}
+
+	void reset() {
+		for(Oversampler &o : detector)
+			o.reset();
+		for(LookaheadChannel &ch : channels) {
+			std::fill(ch.delay.begin(), ch.delay.end(), 0.f);
+			std::fill(ch.delayCenter.begin(), ch.delayCenter.end(), 0.f);
+			std::fill(ch.delaySize.begin(), ch.delaySize.end(), 0.f);
+			std::fill(ch.holds.begin(), ch.holds.end(), 1.f);
+			ch.holdSum = length + 1;
+			ch.dequeSize = 0;
+		}
+		frame = 0;
+		holdPos = 0;
+		holdOldest = 1;
+		delayPos = 0;
+		delayRead = 1;
+	}
+
+	int getHoldCapacity() const {
+		return maxLength + 2;
+	}
+
+	int getDelayCapacity() const {
+		return maxLength + DETECTOR_LATENCY + 1;
+	}
+
+	//call once per frame before process(); a new lookahead keeps the signal and gains in the
+	//buffers, which always hold the longest lookahead, so moving the knob does not mute the output
+	void advance() {
+		const int length = std::min(getLength(clamp(lookahead, MIN_LOOKAHEAD_MS, MAX_LOOKAHEAD_MS)), maxLength);
+		if(length != this->length) {
+			this->length = length;
+			sumHolds();
+		}
+		++frame;
+
+		//the oldest hold is length + 1 frames back and the delay read length + latency back
+		if(++holdPos >= getHoldCapacity())
+			holdPos = 0;
+		holdOldest = holdPos - (length + 1);
+		if(holdOldest < 0)
+			holdOldest += getHoldCapacity();
+		if(++delayPos >= getDelayCapacity())
+			delayPos = 0;
+		delayRead = delayPos - (length + DETECTOR_LATENCY);
+		if(delayRead < 0)
+			delayRead += getDelayCapacity();
+	}
+
+	//average the last length + 1 holds again after the window changed size
+	void sumHolds() {
+		const int cap = getHoldCapacity();
+		for(LookaheadChannel &ch : channels) {
+			double sum = 0.0;
+			for(int i = 0; i <= length; ++i)
+				sum += ch.holds[(holdPos - i + cap) % cap];
+			ch.holdSum = sum;
+		}
+	}
+
+	//size is the distance the output may reach from the limit center; both are delayed with the
+	//signal so each sample is limited around the values it was measured against.
+	//Lanes past the channel count are left out of the scalar part
+	float_4 process(int c, float_4 x, float_4 center, float_4 size, int lanes) {
+		x -= center;
+		float_4 phases[4];
+		detector[c / 4].upsample(x, phases);
+		float_4 peak = simd::fabs(phases[0]);
+		for(int m = 1; m < 4; ++m)
+			peak = simd::fmax(peak, simd::fabs(phases[m]));
+		size = simd::fmax(size, 0.f);
+		const float_4 required = simd::ifelse(peak > size, size / peak, 1.f);
+
+		float out[4] = {};
+		for(int i = 0; i < lanes; ++i)
+			out[i] = processChannel(channels[c + i], x[i], center[i], size[i], required[i]);
+		return float_4::load(out);
+	}
+
+	float processChannel(LookaheadChannel &ch, float x, float center, float size, float required) {
+		const int cap = getHoldCapacity();
+
+		//drop expired gains from the front and larger ones from the back; the hold spans one
+		//extra frame so both samples around an inter-sample peak are reduced. A shorter lookahead
+		//expires several at once, and a longer one only holds the gains still in the deque
+		while(ch.dequeSize > 0 && ch.dequeFrame[ch.dequeHead] <= frame - (length + 2)) {
+			if(++ch.dequeHead >= cap)
+				ch.dequeHead = 0;
+			--ch.dequeSize;
+		}
+		int back = ch.dequeHead + ch.dequeSize;
+		if(back >= cap)
+			back -= cap;
+		while(ch.dequeSize > 0) {
+			const int last = (back > 0)? back - 1 : cap - 1;
+			if(ch.dequeGain[last] < required)
+				break;
+			back = last;
+			--ch.dequeSize;
+		}
+		ch.dequeFrame[back] = frame;
+		ch.dequeGain[back] = required;
+		++ch.dequeSize;
+		const float hold = ch.dequeGain[ch.dequeHead];
+
+		//average the holds over the lookahead so the gain ramps down before the peak
+		ch.holdSum += hold - ch.holds[holdOldest];
+		ch.holds[holdPos] = hold;
+		const float gain = ch.holdSum / (length + 1);
+
+		ch.delay[delayPos] = x;
+		ch.delayCenter[delayPos] = center;
+		ch.delaySize[delayPos] = size;
+		//the averaged gain can leave a small overshoot on the steepest attacks
+		const float delayedSize = ch.delaySize[delayRead];
+		return ch.delayCenter[delayRead] + clamp(gain * ch.delay[delayRead], -delayedSize, delayedSize);
+	}
+};
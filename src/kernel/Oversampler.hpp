@@ -0,0 +1,114 @@
+#pragma once
+#include "Signal.hpp"
+#include <dsp/common.hpp>
+
+//taps per polyphase branch; the up and down sampling round trip delays by this many samples
+static const int OVERSAMPLE_TAPS = 8;
+static const int MAX_OVERSAMPLE = 8;
+static const int MAX_OVERSAMPLE_LEN = MAX_OVERSAMPLE * OVERSAMPLE_TAPS + 1;
+
+//Blackman windowed sinc lowpass at the host Nyquist frequency
+struct OversampleFilter {
+	int factor;
+	int length;
+	//full kernel for decimation
+	float taps[MAX_OVERSAMPLE_LEN];
+	//kernel split into branches for interpolation
+	float phases[MAX_OVERSAMPLE][OVERSAMPLE_TAPS + 1];
+
+	OversampleFilter(int factor) : factor(factor), length(factor * OVERSAMPLE_TAPS + 1) {
+		const float center = (length - 1) / 2.f;
+		float sum = 0.f;
+		for(int i = 0; i < length; ++i) {
+			const float w = 2.f * M_PI * i / (length - 1);
+			taps[i] = dsp::sinc((i - center) / factor) * (0.42f - 0.5f * std::cos(w) + 0.08f * std::cos(2.f * w));
+			sum += taps[i];
+		}
+		for(int i = 0; i < length; ++i)
+			taps[i] /= sum;
+
+		//normalize each branch so every interpolated sample has unity gain at DC
+		for(int m = 0; m < factor; ++m) {
+			float phaseSum = 0.f;
+			for(int k = 0; k <= OVERSAMPLE_TAPS; ++k) {
+				const int i = m + k * factor;
+				phases[m][k] = (i < length)? taps[i] : 0.f;
+				phaseSum += phases[m][k];
+			}
+			for(int k = 0; k <= OVERSAMPLE_TAPS; ++k)
+				phases[m][k] /= phaseSum;
+		}
+	}
+};
+
+//computed once when the plugin loads
+static const OversampleFilter oversampleFilters[] = {OversampleFilter(2), OversampleFilter(4), OversampleFilter(8)};
+
+static const OversampleFilter* getOversampleFilter(int factor) {
+	for(const OversampleFilter &filter : oversampleFilters) {
+		if(filter.factor == factor)
+			return &filter;
+	}
+	return nullptr;
+}
+
+//polyphase up and down sampler for 4 channels
+struct Oversampler {
+	const OversampleFilter *filter = nullptr;
+	//host rate input, newest first
+	float_4 upHistory[OVERSAMPLE_TAPS + 1];
+	//oversampled signal written twice so the filter window is never split
+	float_4 downHistory[2 * MAX_OVERSAMPLE_LEN];
+	int downPos = 0;
+
+	Oversampler() {
+		reset();
+	}
+	void setFilter(const OversampleFilter *f) {
+		filter = f;
+		reset();
+	}
+	void reset() {
+		for(float_4 &x : upHistory)
+			x = 0.f;
+		for(float_4 &x : downHistory)
+			x = 0.f;
+		downPos = 0;
+	}
+	int getFactor() const {
+		return filter? filter->factor : 1;
+	}
+
+	void upsample(float_4 in, float_4 *out) {
+		for(int k = OVERSAMPLE_TAPS; k > 0; --k)
+			upHistory[k] = upHistory[k - 1];
+		upHistory[0] = in;
+
+		for(int m = 0; m < filter->factor; ++m) {
+			float_4 sum = 0.f;
+			for(int k = 0; k <= OVERSAMPLE_TAPS; ++k)
+				sum += filter->phases[m][k] * upHistory[k];
+			out[m] = sum;
+		}
+	}
+
+	float_4 downsample(const float_4 *in) {
+		//filter at the first phase so the total delay is a whole number of host samples
+		push(in[0]);
+		const float_4 *window = &downHistory[downPos];
+		float_4 sum = 0.f;
+		for(int i = 0; i < filter->length; ++i)
+			sum += filter->taps[i] * window[i];
+
+		for(int m = 1; m < filter->factor; ++m)
+			push(in[m]);
+		return sum;
+	}
+
+	void push(float_4 x) {
+		downHistory[downPos] = x;
+		downHistory[downPos + filter->length] = x;
+		if(++downPos >= filter->length)
+			downPos = 0;
+	}
+};
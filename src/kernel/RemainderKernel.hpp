@@ -0,0 +1,267 @@
+#pragma once
+#include "Oversampler.hpp"
+
+//high pass corner of the feedback DC blocker in Hz
+static const float STABILIZER_CUTOFF = 10.f;
+//voltage the feedback saturator levels off at
+static const float STABILIZER_LEVEL = 10.f;
+//largest quotient of the fast fold; keeps the conversion to int32 in range, and lanes reaching
+//it fall back to the exact quotients
+static const float FAST_FOLD_LIMIT = 4194304.f;
+
+//one-pole DC blocker fused with a soft saturator for the feedback path of 4 channels;
+//the recursive state is kept in double so the pole close to 1 does not drift
+struct FeedbackStabilizer {
+	//previous input and output for channels 0-1 and 2-3
+	__m128d x1[2];
+	__m128d y1[2];
+	__m128d pole;
+
+	FeedbackStabilizer() {
+		setSampleRate(44100.f);
+		reset();
+	}
+
+	void setSampleRate(float sampleRate) {
+		pole = _mm_set1_pd(std::exp(-2.0 * M_PI * STABILIZER_CUTOFF / sampleRate));
+	}
+
+	void reset() {
+		for(int h = 0; h < 2; ++h) {
+			x1[h] = _mm_setzero_pd();
+			y1[h] = _mm_setzero_pd();
+		}
+	}
+
+	float_4 process(float_4 x) {
+		//y = x - x1 + pole * y1 in double precision
+		const __m128d in[2] = {_mm_cvtps_pd(x.v), _mm_cvtps_pd(_mm_movehl_ps(x.v, x.v))};
+		for(int h = 0; h < 2; ++h) {
+			y1[h] = _mm_add_pd(_mm_sub_pd(in[h], x1[h]), _mm_mul_pd(pole, y1[h]));
+			x1[h] = in[h];
+		}
+		const float_4 y = _mm_movelh_ps(_mm_cvtpd_ps(y1[0]), _mm_cvtpd_ps(y1[1]));
+
+		//rational tanh approximation; reaches the level with zero slope at the clamp
+		const float_4 s = clamp(y / STABILIZER_LEVEL, -3.f, 3.f);
+		return STABILIZER_LEVEL * s * (27.f + s * s) / (27.f + 9.f * s * s);
+	}
+};
+
+struct RemainderKernel {
+	struct Controls {
+		float gain;
+		float gainCv;
+		float fold;
+		float feedback;
+		float feedbackCv;
+		float shape;
+		float shapeCv;
+		float mix;
+		float mixCv;
+	};
+	struct Inputs {
+		Signal audio;
+		Signal gain;
+		Signal feedback;
+		Signal shape;
+		Signal mix;
+		Signal fold;
+	};
+
+	//feedback state for 16 channels
+	float_4 lastWet[4] = {};
+
+	bool antiAlias = false;
+	//previous fold input for anti-aliasing
+	float_4 lastIn[4] = {};
+
+	//oversampling factor, 1 when disabled
+	int oversample = 1;
+	Oversampler oversampler[4];
+
+	//DC block and saturate the feedback signal
+	bool stabilize = false;
+	FeedbackStabilizer stabilizer[4];
+	float sampleRate = 44100.f;
+	//rate the stabilizer poles were last set for
+	float stabilizerRate = 0.f;
+
+	//multiply by the reciprocal of the divisor instead of dividing every sample
+	bool fastFold = false;
+	//divisor of each group the reciprocal was last computed for
+	float_4 recipDivisor[4] = {};
+	float_4 reciprocal[4] = {};
+
+	void process(const Controls &controls, const Inputs &inputs, float *out, int channels) {
+		//switch oversampling here so history is never reset mid block
+		const OversampleFilter *filter = getOversampleFilter(oversample);
+		if(oversampler[0].filter != filter) {
+			for(Oversampler &os : oversampler)
+				os.setFilter(filter);
+		}
+		const int factor = oversampler[0].getFactor();
+
+		//feedback runs at the oversampled rate
+		if(stabilize && stabilizerRate != sampleRate * factor) {
+			stabilizerRate = sampleRate * factor;
+			for(FeedbackStabilizer &s : stabilizer)
+				s.setSampleRate(stabilizerRate);
+		}
+
+		//process 4 channels at a time; monophonic CV applies to all channels
+		for(int c = 0; c < channels; c += 4) {
+			float_4 dry = inputs.audio.getVoltageSimd(c);
+			float_4 gain = controls.gain + controls.gainCv * inputs.gain.getPolyVoltageSimd(c);
+			float_4 divisor = controls.fold + inputs.fold.getPolyVoltageSimd(c);
+			float_4 feedback = controls.feedback + controls.feedbackCv * inputs.feedback.getPolyVoltageSimd(c) / 10.f;
+
+			float_4 shape = controls.shape + controls.shapeCv * inputs.shape.getPolyVoltageSimd(c) / 10.f;
+			shape = clamp(shape, 0.f, 1.f);
+
+			float_4 mix = controls.mix + controls.mixCv * inputs.mix.getPolyVoltageSimd(c) / 10.f;
+			mix = clamp(mix, 0.f, 1.f);
+
+			//only recompute when the knob or fold CV moves
+			if(fastFold && simd::movemask(divisor != recipDivisor[c / 4])) {
+				recipDivisor[c / 4] = divisor;
+				reciprocal[c / 4] = 1.f / divisor;
+			}
+
+			float_4 &wet = lastWet[c / 4];
+			float_4 y;
+			if(factor > 1) {
+				//fold at the higher rate with controls held for the whole frame
+				float_4 upDry[MAX_OVERSAMPLE];
+				float_4 upOut[MAX_OVERSAMPLE];
+				oversampler[c / 4].upsample(dry, upDry);
+				for(int m = 0; m < factor; ++m) {
+					wet = foldSample(c / 4, upDry[m] * gain + feedbackSample(c / 4, wet) * feedback, divisor, shape);
+					upOut[m] = crossfade(upDry[m], wet, mix);
+				}
+				y = oversampler[c / 4].downsample(upOut);
+			}
+			else {
+				//attenuate audio and add feedback
+				wet = foldSample(c / 4, dry * gain + feedbackSample(c / 4, wet) * feedback, divisor, shape);
+				y = crossfade(dry, wet, mix);
+			}
+			y.store(&out[c]);
+		}
+	}
+
+	float_4 feedbackSample(int group, float_4 wet) {
+		return stabilize? stabilizer[group].process(wet) : wet;
+	}
+
+	float_4 foldSample(int group, float_4 in, float_4 divisor, float_4 shape) {
+		const float_4 *recip = fastFold? &reciprocal[group] : nullptr;
+		if(!antiAlias)
+			return fold(in, divisor, shape, recip);
+
+		const float_4 wet = foldAdaa(in, lastIn[group], divisor, shape, recip);
+		lastIn[group] = in;
+		return wet;
+	}
+
+	//quotients of both folds from one multiply: q = trunc(x / d) and qSigned = round(x / 2d).
+	//The reciprocal and the product each round once, so the quotient is within 2^-22 * |x / d| of
+	//the divided one. Both folds match the exact path bit for bit except for inputs that close to
+	//a fold edge, where the output may come from the other side of the jump, a whole period away.
+	//Exact ties round x / 2d up instead of away from zero, which is also an edge.
+	//Returns the lanes clamped at FAST_FOLD_LIMIT, whose quotients the caller must divide for
+	static float_4 fastQuotients(float_4 x, float_4 recip, float_4 &q, float_4 &qSigned) {
+		const float_4 u = clamp(x * recip, -FAST_FOLD_LIMIT, FAST_FOLD_LIMIT);
+		const __m128i t = _mm_cvttps_epi32(u.v);
+		q = _mm_cvtepi32_ps(t);
+		//floor(u) is trunc(u) less one below zero; halving floor(u) + 1 rounds u / 2
+		const __m128i f = _mm_add_epi32(t, _mm_castps_si128((q > u).v));
+		qSigned = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_add_epi32(f, _mm_set1_epi32(1)), 1));
+		return simd::fabs(u) >= FAST_FOLD_LIMIT;
+	}
+
+	//divides by the divisor unless its reciprocal is given
+	static float_4 fold(float_4 in, float_4 divisor, float_4 shape, const float_4 *recip = nullptr) {
+		//avoid divide by zero
+		const float_4 canFold = simd::fabs(divisor) > 0.01f;
+
+		//fold audio using remainder
+		float_4 remainder, remSigned;
+		if(recip) {
+			float_4 q, qSigned;
+			const float_4 far = fastQuotients(in, *recip, q, qSigned);
+			if(simd::movemask(far)) {
+				q = simd::ifelse(far, truncExact(in / divisor), q);
+				qSigned = simd::ifelse(far, roundExact(in / (2.f * divisor)), qSigned);
+			}
+			remainder = q * divisor;
+			remSigned = qSigned * (2.f * divisor);
+		}
+		else {
+			remainder = truncExact(in / divisor) * divisor;
+			divisor *= 2.f;
+			remSigned = roundExact(in / divisor) * divisor;
+		}
+
+		return simd::ifelse(canFold, in - crossfade(remainder, remSigned, shape), 0.f);
+	}
+
+	//first order antiderivative anti-aliasing between the previous input in1 and in
+	static float_4 foldAdaa(float_4 in, float_4 in1, float_4 divisor, float_4 shape, const float_4 *recip = nullptr) {
+		const float_4 dx = in - in1;
+		//slope is ill-conditioned for nearly equal inputs; use the midpoint instead
+		const float_4 ill = simd::fabs(dx) < 1e-4f;
+		const float_4 canFold = simd::fabs(divisor) > 0.01f;
+
+		//both folds are odd with period set by |divisor|, so integrate over |in|
+		const float_4 d = simd::fabs(divisor);
+		const float_4 a = simd::fabs(in);
+		const float_4 a1 = simd::fabs(in1);
+
+		//ramp differences are taken from a - a1 so the period offsets cancel exactly
+		const float_4 da = a - a1;
+
+		//periods below a, a1 of both folds; for a >= 0 trunc((a + d) / 2d) is round(a / 2d)
+		float_4 k, k1, j, j1;
+		const float_4 period = 2.f * d;
+		if(recip) {
+			//the reciprocal of the signed divisor differs from 1 / d only in sign
+			const float_4 recipAbs = simd::fabs(*recip);
+			const float_4 far = fastQuotients(a, recipAbs, k, j) | fastQuotients(a1, recipAbs, k1, j1);
+			if(simd::movemask(far)) {
+				k = simd::ifelse(far, truncExact(a / d), k);
+				k1 = simd::ifelse(far, truncExact(a1 / d), k1);
+				j = simd::ifelse(far, truncExact((a + d) / period), j);
+				j1 = simd::ifelse(far, truncExact((a1 + d) / period), j1);
+			}
+		}
+		else {
+			k = truncExact(a / d);
+			k1 = truncExact(a1 / d);
+			j = truncExact((a + d) / period);
+			j1 = truncExact((a1 + d) / period);
+		}
+
+		//unsigned remainder ramps 0 to d; integral is k*d*d/2 + r*r/2
+		const float_4 r = a - k * d;
+		const float_4 r1 = a1 - k1 * d;
+		const float_4 unsignedDiff = 0.5f * ((k - k1) * d * d + (da - (k - k1) * d) * (r + r1));
+
+		//signed remainder ramps -d to d with zero mean; integral is (p*p - 2*d*p)/2.
+		//d is added last so a + d from the divided quotient is not shared into the ramp, which
+		//Rack's reassociating float flags would otherwise round differently on the two paths
+		const float_4 p = (a - j * period) + d;
+		const float_4 p1 = (a1 - j1 * period) + d;
+		const float_4 signedDiff = 0.5f * (da - (j - j1) * period) * (p + p1 - period);
+
+		const float_4 wet = simd::ifelse(ill, fold(0.5f * (in + in1), divisor, shape, recip),
+			crossfade(unsignedDiff, signedDiff, shape) / dx);
+		return simd::ifelse(canFold, wet, 0.f);
+	}
+
+	//delay added by the resampling filters in samples; follows the filter in use, which
+	//process() switches to the selected factor on its next frame
+	int getLatency() const {
+		return oversampler[0].filter? OVERSAMPLE_TAPS : 0;
+	}
+};
@@ -0,0 +1,59 @@
+#pragma once
+#include <simd/functions.hpp>
+
+using namespace rack;
+using simd::float_4;
+
+//how a port is patched
+enum Polyphony {
+	DISCONNECTED,
+	MONO,
+	POLY
+};
+
+//voltages of one port as a plain buffer, so kernels can run without the engine; the port is
+//classified when the signal is made and unless it is polyphonic every lane reads one broadcast value
+struct Signal {
+	const float *voltages;
+	int channels;
+	Polyphony polyphony;
+	//value of every lane of disconnected and mono ports
+	float_4 broadcast;
+
+	Signal() : voltages(silence()), channels(0), polyphony(DISCONNECTED), broadcast(0.f) {}
+	Signal(const float *voltages, int channels) : voltages(voltages), channels(channels),
+		polyphony((channels > 1)? POLY : (channels == 1)? MONO : DISCONNECTED),
+		broadcast((channels == 1)? voltages[0] : 0.f) {}
+
+	bool isConnected() const {
+		return channels > 0;
+	}
+	float getVoltage(int c = 0) const {
+		return voltages[c];
+	}
+	//per channel when polyphonic, otherwise the same for every channel
+	float getPolyVoltage(int c) const {
+		return (polyphony == POLY)? voltages[c] : broadcast[0];
+	}
+	float_4 getVoltageSimd(int c) const {
+		return float_4::load(&voltages[c]);
+	}
+	float_4 getPolyVoltageSimd(int c) const {
+		return (polyphony == POLY)? float_4::load(&voltages[c]) : broadcast;
+	}
+
+	static const float* silence() {
+		static const float zeros[16] = {};
+		return zeros;
+	}
+};
+
+//simd::trunc converts through int32; floats past 2^23 are already whole
+inline float_4 truncExact(float_4 x) {
+	return simd::ifelse(simd::fabs(x) < 8388608.f, simd::trunc(x), x);
+}
+//round half away from zero, matching std::round
+inline float_4 roundExact(float_4 x) {
+	const float_4 t = truncExact(x);
+	return t + simd::ifelse(simd::fabs(x - t) >= 0.5f, simd::sgn(x), 0.f);
+}
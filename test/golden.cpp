@@ -0,0 +1,249 @@
+//Golden output test of the DSP kernels; built by `make test` without Rack or GUI libraries.
+//Every kernel mode runs from a fresh state at 1, 4, 8 and 16 channels with CV disconnected and
+//connected, and every output sample is compared with the reference written by `make golden`.
+//Exits non-zero at the first sample outside its tolerance and reports where it is.
+//The stimuli come from integer math, but the kernels round according to the compiler and its
+//float flags, so references only compare against a build with the same configuration.
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../bench/Harness.hpp"
+
+//frames compared per case from a fresh kernel
+static const int GOLDEN_FRAMES = 1024;
+static const uint32_t GOLDEN_MAGIC = 0x444c4741;
+
+//allowed difference |got - expected| <= abs + rel * |expected|; zero for both compares the bits
+struct Tolerance {
+	float abs;
+	float rel;
+};
+static const Tolerance EXACT = {0.f, 0.f};
+//modes filtering through coefficient tables computed with the C library's sin, cos and exp when
+//the plugin loads, which may differ in the last bits between C libraries in the same configuration
+static const Tolerance TABLES = {1e-5f, 1e-4f};
+
+//compiler, vector units and float flags that change how the kernels round; clang does not report
+//-funsafe-math-optimizations, so its reassociating builds only show up with -ffast-math
+static std::string getBuildConfiguration() {
+	std::string configuration;
+#if defined(__clang__)
+	configuration += "clang " + std::to_string(__clang_major__);
+#elif defined(__GNUC__)
+	configuration += "gcc " + std::to_string(__GNUC__);
+#else
+	configuration += "unknown compiler";
+#endif
+#if defined(__x86_64__)
+	configuration += " x86_64";
+#elif defined(__aarch64__)
+	configuration += " arm64";
+#endif
+#ifdef __AVX__
+	configuration += " avx";
+#endif
+#if defined(__FMA__) || defined(__ARM_FEATURE_FMA)
+	configuration += " fma";
+#endif
+#ifdef __FAST_MATH__
+	configuration += " fast-math";
+#endif
+#ifdef __ASSOCIATIVE_MATH__
+	configuration += " associative-math";
+#endif
+#ifdef __RECIPROCAL_MATH__
+	configuration += " reciprocal-math";
+#endif
+	return configuration;
+}
+
+//every output buffer of one frame, in the order the harness hands them over
+struct FrameRecorder {
+	std::vector<float> voltages;
+	int channels = 0;
+
+	void add(const float *buffer, int channels) {
+		voltages.insert(voltages.end(), buffer, buffer + channels);
+		this->channels = channels;
+	}
+};
+
+//frames of one case; each frame stores the samples that changed from the previous one (silence
+//before the first) as index and value pairs, or the whole frame when more than half changed
+struct GoldenFile {
+	uint32_t width = 0;
+	std::vector<std::vector<float>> frames;
+
+	bool read(const std::string &path) {
+		FILE *file = std::fopen(path.c_str(), "rb");
+		if(!file)
+			return false;
+		uint32_t header[3];
+		bool ok = std::fread(header, sizeof(header), 1, file) == 1 && header[0] == GOLDEN_MAGIC;
+		width = ok? header[2] : 0;
+		std::vector<float> frame(width, 0.f);
+		uint32_t changes;
+		while(ok && frames.size() < header[1] && std::fread(&changes, sizeof(changes), 1, file) == 1) {
+			if(changes == width) {
+				ok = width == 0 || std::fread(frame.data(), sizeof(float) * width, 1, file) == 1;
+			}
+			else {
+				for(uint32_t j = 0; ok && j < changes; ++j) {
+					uint32_t index;
+					ok = std::fread(&index, sizeof(index), 1, file) == 1 && index < width
+						&& std::fread(&frame[index], sizeof(float), 1, file) == 1;
+				}
+			}
+			frames.push_back(frame);
+		}
+		std::fclose(file);
+		return ok && frames.size() == header[1];
+	}
+
+	bool write(const std::string &path) const {
+		FILE *file = std::fopen(path.c_str(), "wb");
+		if(!file)
+			return false;
+		const uint32_t header[3] = {GOLDEN_MAGIC, uint32_t(frames.size()), width};
+		std::fwrite(header, sizeof(header), 1, file);
+		std::vector<float> previous(width, 0.f);
+		std::vector<uint32_t> changed;
+		for(const std::vector<float> &frame : frames) {
+			changed.clear();
+			for(uint32_t i = 0; i < width; ++i) {
+				if(!equalBits(frame[i], previous[i]))
+					changed.push_back(i);
+			}
+			uint32_t changes = (changed.size() * 2 > width)? width : changed.size();
+			std::fwrite(&changes, sizeof(changes), 1, file);
+			if(changes == width) {
+				std::fwrite(frame.data(), sizeof(float) * width, 1, file);
+			}
+			else {
+				for(uint32_t index : changed) {
+					std::fwrite(&index, sizeof(index), 1, file);
+					std::fwrite(&frame[index], sizeof(float), 1, file);
+				}
+			}
+			previous = frame;
+		}
+		return std::fclose(file) == 0;
+	}
+
+	static bool equalBits(float a, float b) {
+		return std::memcmp(&a, &b, sizeof(float)) == 0;
+	}
+};
+
+static bool withinTolerance(float got, float expected, Tolerance tolerance) {
+	if(std::memcmp(&got, &expected, sizeof(float)) == 0)
+		return true;
+	return std::fabs(got - expected) <= tolerance.abs + tolerance.rel * std::fabs(expected);
+}
+
+static std::string directory;
+static bool update = false;
+static int cases = 0;
+
+//runs one mode at every channel count; false after reporting the first mismatch
+template <typename TBench>
+bool check(const char *name, Tolerance tolerance) {
+	const int channelCounts[] = {1, 4, 8, 16};
+	for(int channels : channelCounts) {
+		for(int connected = 0; connected < 2; ++connected) {
+			const std::string caseName = std::string(name) + "_" + std::to_string(channels) + "ch_"
+				+ (connected? "connected" : "disconnected");
+			const std::string path = directory + "/" + caseName + ".bin";
+
+			TBench bench(channels, connected);
+			GoldenFile result;
+			for(int frame = 0; frame < GOLDEN_FRAMES; ++frame) {
+				bench.process(frame);
+				FrameRecorder recorder;
+				bench.digest(recorder);
+				result.width = recorder.voltages.size();
+				result.frames.push_back(recorder.voltages);
+			}
+			++cases;
+
+			if(update) {
+				if(!result.write(path)) {
+					std::printf("%s: cannot write %s\n", caseName.c_str(), path.c_str());
+					return false;
+				}
+				continue;
+			}
+
+			GoldenFile golden;
+			if(!golden.read(path) || golden.width != result.width || golden.frames.size() != result.frames.size()) {
+				std::printf("%s: missing or mismatched reference %s; run `make golden` after an intended change\n",
+					caseName.c_str(), path.c_str());
+				return false;
+			}
+			for(int frame = 0; frame < GOLDEN_FRAMES; ++frame) {
+				for(uint32_t i = 0; i < result.width; ++i) {
+					const float got = result.frames[frame][i];
+					const float expected = golden.frames[frame][i];
+					if(withinTolerance(got, expected, tolerance))
+						continue;
+					std::printf("%s: frame %d output %u channel %u: got %.9g, expected %.9g (tolerance abs %g, rel %g)\n",
+						caseName.c_str(), frame, i / channels, i % channels, got, expected, tolerance.abs, tolerance.rel);
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+int main(int argc, char **argv) {
+	if(argc < 2) {
+		std::printf("usage: %s <reference directory> [--update]\n", argv[0]);
+		return 2;
+	}
+	directory = argv[1];
+	update = argc > 2 && std::string(argv[2]) == "--update";
+
+	//the configuration that wrote the references is kept next to them
+	const std::string configuration = getBuildConfiguration();
+	const std::string configurationPath = directory + "/configuration.txt";
+	if(update) {
+		std::ofstream(configurationPath) << configuration << "\n";
+	}
+	else {
+		std::string written;
+		std::getline(std::ifstream(configurationPath), written);
+		if(written != configuration) {
+			std::printf("references were written by a \"%s\" build and this is a \"%s\" build, which rounds differently;\n"
+				"run `make golden` on the unchanged tree to write references for this build\n", written.c_str(), configuration.c_str());
+			return 1;
+		}
+	}
+
+	const bool passed = check<BCrushBench>("BCrush", EXACT)
+		&& check<BCrushBlepBench>("BCrushBlep", TABLES)
+		&& check<ClipBench>("Clip", EXACT)
+		&& check<ClipMonoCvBench>("ClipMonoCv", EXACT)
+		&& check<ClipAdaaBench>("ClipAdaa", EXACT)
+		&& check<ClipBandsBench>("Clip3Band", TABLES)
+		&& check<ClipLookaheadBench>("ClipLookahead", TABLES)
+		&& check<ClipLookaheadDragBench>("ClipLookaheadDrag", TABLES)
+		&& check<RemainderBench>("Remainder", EXACT)
+		&& check<RemainderFastBench>("RemainderFast", EXACT)
+		&& check<RemainderAdaaBench>("RemainderAdaa", EXACT)
+		&& check<RemainderFastAdaaBench>("RemainderFastAdaa", EXACT)
+		&& check<RemainderOversampleBench>("Remainder4x", TABLES)
+		&& check<RemainderStabilizeBench>("RemainderStable", TABLES)
+		&& check<ClockDivBench>("ClockDiv", EXACT)
+		&& check<ClockDivRatioBench>("ClockDivRatio", EXACT)
+		&& check<ClockDivCycleBench>("ClockDivCycle", EXACT)
+		&& check<ClockDivSequenceBench>("ClockDivSeq", EXACT)
+		&& check<ClockDivPreciseBench>("ClockDivPrecise", EXACT);
+	if(!passed)
+		return 1;
+
+	std::printf("%s %d cases of %d frames\n", update? "wrote" : "passed", cases, GOLDEN_FRAMES);
+	return 0;
+}